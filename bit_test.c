@@ -84,16 +84,19 @@ measurement_p bit_measurement_create(test_p tst, char *label) {
 void bit_SHMEM_test(test_p tst, measurement_p m) {
 #ifdef SHMEM
 	buffer_t *abuf, *bbuf, *cbuf;
-	int i, j, k, icycle, istage, partner_rank;
+	int i, j, k, icycle, istage, partner_rank, stop = 0;
 	unsigned char pattern;
-	abuf = comm_newbuffer(m->buflen);							/* set up exchange buffers */
-	bbuf = comm_newbuffer(m->buflen);
-	cbuf = comm_newbuffer(m->buflen);
-	for (icycle = 0; icycle < tst->num_cycles; icycle++) {					/* multiple cycles repeat the test */
+	abuf = tst->buf[0];								/* set up exchange buffers */
+	bbuf = tst->buf[1];
+	cbuf = tst->buf[2];
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {			/* multiple cycles repeat the test */
 		for (istage = 0; istage < tst->num_stages; istage++) {				/* step through the stage schedule */
-			partner_rank = my_rank ^ istage;					/* who's my partner for this stage? */
+			if ((stop = comm_time_expired(tst)))					/* out of time? stop at a stage boundary */
+				break;
+			partner_rank = comm_partner(tst, istage);				/* who's my partner for this stage? */
 			shmem_barrier_all();
-			if ((partner_rank < num_ranks) && (partner_rank != my_rank)) {		/* valid pair? proceed with test */
+			if (partner_rank >= 0) {						/* valid pair? proceed with test */
 				for (k=0x00; k< 0x100; k++) {		/* try each byte patter */
 					pattern=k;
 					for (i=0; i<m->buflen; i++) ((unsigned char *)(abuf->data))[i]=pattern;
@@ -112,9 +115,6 @@ void bit_SHMEM_test(test_p tst, measurement_p m) {
 		} /* for istage */
 	} /* for icycle */
 	shmem_barrier_all();
-	comm_freebuffer(cbuf);
-	comm_freebuffer(bbuf);
-	comm_freebuffer(abuf);
 #endif
 	return;
 }
@@ -133,16 +133,19 @@ void bit_MPI_test(test_p tst, measurement_p m) {
 #ifndef SHMEM
 	MPI_Status mpistatus;
 	buffer_t *abuf, *bbuf, *cbuf;
-	int i, j, k, icycle, istage, ierr, partner_rank;
+	int i, j, k, icycle, istage, ierr, partner_rank, stop = 0;
 	unsigned char pattern;
-	abuf = comm_newbuffer(m->buflen);							/* set up exchange buffers */
-	bbuf = comm_newbuffer(m->buflen);
-	cbuf = comm_newbuffer(m->buflen);
-	for (icycle = 0; icycle < tst->num_cycles; icycle++) {					/* multiple cycles repeat the test */
+	abuf = tst->buf[0];								/* set up exchange buffers */
+	bbuf = tst->buf[1];
+	cbuf = tst->buf[2];
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {			/* multiple cycles repeat the test */
 		for (istage = 0; istage < tst->num_stages; istage++) {				/* step through the stage schedule */
-			partner_rank = my_rank ^ istage;					/* who's my partner for this stage? */
+			if ((stop = comm_time_expired(tst)))					/* out of time? stop at a stage boundary */
+				break;
+			partner_rank = comm_partner(tst, istage);				/* who's my partner for this stage? */
 			ierr = MPI_Barrier(MPI_COMM_WORLD);
-			if ((partner_rank < num_ranks) && (partner_rank != my_rank) && (partner_rank >= 0)) {		/* valid pair? proceed with test */
+			if (partner_rank >= 0) {						/* valid pair? proceed with test */
 				for (k=0x00; k<0x100; k++) {		/* try each byte pattern */
 					pattern=k;
 					for (i=0; i<m->buflen; i++) ((unsigned char*)(abuf->data))[i]=pattern;
@@ -163,9 +166,6 @@ void bit_MPI_test(test_p tst, measurement_p m) {
 		} /* for istage */
 	} /* for icycle */
 	ierr = MPI_Barrier(MPI_COMM_WORLD);
-	comm_freebuffer(cbuf);
-	comm_freebuffer(bbuf);
-	comm_freebuffer(abuf);
 #endif
 	return;
 }
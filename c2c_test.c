@@ -0,0 +1,311 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+/**
+ * \brief Times a cache line bouncing between two CPUs of the node, for
+ * every pair of CPUs this rank may run on.
+ *
+ * Pros: 
+ * - Assesses the raw cost of moving a cache line between cores, without
+ *   the MPI library's shared-memory transport
+ * - Provides a CPU x CPU matrix per node, alongside the usual histograms
+ *
+ * Cons:
+ * - Round trips only (two line transfers per sample)
+ * - Run one rank per node: every rank tests the CPUs of its affinity mask
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "config.h"
+#include "orbtimer.h"
+#include "comm.h"
+#include "tests.h"
+#include "measurement.h"
+#include "placement.h"
+
+/* number of core-to-core histograms */
+#define C2C_LEN 6
+
+/* histograms for core-to-core measurements */
+enum c2c_vars {
+	/* timer overhead */
+	c2cTimer,
+	/* all CPU pairs */
+	roundTrip, roundTripMinimum,
+	/* CPU pairs by placement class (PLACE_L3, PLACE_SOCKET, PLACE_CROSS) */
+	sameL3RoundTrip, sameSocketRoundTrip, crossSocketRoundTrip
+};
+
+char *c2c_labels[] = {
+	/* timer overhead */
+	"timer",
+	/* all CPU pairs */
+	"roundTrip", "roundTripMinimum",
+	/* CPU pairs by placement class */
+	"sameL3RoundTrip", "sameSocketRoundTrip", "crossSocketRoundTrip"
+};
+
+/* the cache line bounced between the two CPUs */
+typedef struct c2c_line {
+	volatile uint64_t flag;
+	char pad[CACHELINE - sizeof(uint64_t)];
+} c2c_line_t, *c2c_line_p;
+
+/* the responding side of a CPU pair */
+typedef struct c2c_pong {
+	c2c_line_p line;
+	int cpu;
+	int rounds;
+} c2c_pong_t;
+
+/**
+ \brief Create the measurement struct for the test
+ \param tst Will tell the test how many times to run
+ \param label A label for the measurement struct
+*/
+measurement_p c2c_measurement_create(test_p tst, char *label) {
+	int i;
+	measurement_p m = measurement_real_create(tst, label, C2C_LEN);
+	for (i = 0; i < C2C_LEN; i++)
+		strncpy(m->hist[i].label,c2c_labels[i],LABEL_LEN);
+	/* adaptive sampling watches the round trips of all pairs */
+	m->hist[roundTrip].converge = 1;
+	return m;
+}
+
+/**
+ \brief Binds the calling thread to one CPU
+ \return 0, or an errno value
+*/
+static int c2c_pin(int cpu) {
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+}
+
+/**
+ \brief Answers each ping on the line, pinned to its CPU
+ \param arg The responder (c2c_pong_t *)
+*/
+static void *c2c_pong(void *arg) {
+	c2c_pong_t *p = (c2c_pong_t *)arg;
+	uint64_t r;
+	c2c_pin(p->cpu);
+	for (r = 0; r < (uint64_t)p->rounds; r++) {
+		while (p->line->flag != 2 * r + 1)
+			;
+		p->line->flag = 2 * r + 2;
+	}
+	return NULL;
+}
+
+/**
+ \brief Orders tick counts for the per-pair median
+*/
+static int c2c_cmp(const void *a, const void *b) {
+	ORB_tick_t x = *(const ORB_tick_t *)a;
+	ORB_tick_t y = *(const ORB_tick_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ \brief Writes the CPU x CPU matrices of median and minimum round trips to
+ <label>.C2C.<rank>
+ \param cpus The CPUs tested
+ \param med Sum over the cycles of each pair's median, in ticks
+ \param min Minimum of each pair, in ticks
+ \param cycles Cycles the medians were summed over
+*/
+static void c2c_write(test_p tst, measurement_p m, int *cpus, int ncpu, double *med, ORB_tick_t *min, int cycles) {
+	char fname[FNAMESIZE];
+	double v, freq = ORB_REFFREQ;
+	FILE *F;
+	int k, a, b;
+
+	snprintf(fname, FNAMESIZE, "%s/%s.C2C.%d", tst->case_name, m->label, my_rank);
+	F = fopen(fname, "w");
+	assert(F != NULL);
+	measurement_print_header(F, tst, m->label, NULL);
+	fprintf(F, "# Node:              %s (rank %d), %d CPUs\n", nodename, my_rank, ncpu);
+	fprintf(F, "# Matrices:          median (averaged over %d cycle(s)), then minimum round trip in nsec\n", cycles);
+	for (k = 0; k < 2; k++) {
+		fprintf(F, "%s%-8s", (k == 0) ? "" : "\n", (k == 0) ? "#median" : "#minimum");
+		for (b = 0; b < ncpu; b++)
+			fprintf(F, " %8d", cpus[b]);
+		fprintf(F, "\n");
+		for (a = 0; a < ncpu; a++) {
+			fprintf(F, "%8d", cpus[a]);
+			for (b = 0; b < ncpu; b++) {
+				if ((a == b) || (cycles == 0)) {
+					fprintf(F, " %8s", "-");
+					continue;
+				}
+				v = (k == 0) ? med[a * ncpu + b] / cycles : (double)min[a * ncpu + b];
+				fprintf(F, " %8.1f", v / freq * 1.0e+9);
+			}
+			fprintf(F, "\n");
+		}
+	}
+	fclose(F);
+}
+
+/**
+ \brief Bounces a cache line between every pair of CPUs in this rank's
+ affinity mask, timing each round trip from the first CPU of the pair
+ \param tst Gives the cycles, warmups and round trips per pair
+ \param m Collects measurement data from the test
+
+ The calling thread pings from the first CPU, a thread pinned to the
+ second CPU answers. No messages are exchanged between ranks, only the
+ per-cycle time limit and adaptive sampling checks are collective.
+*/
+void c2c_test(test_p tst, measurement_p m) {
+	cpu_set_t mask;
+	c2c_line_p line;
+	c2c_pong_t pong;
+	pthread_t tid;
+	ORB_tick_t *cos, *t, *min, cmin;
+	double *med;
+	int *cpus, ncpu = 0, a, b, i, r, rounds, place, icycle, cycles = 0, stop = 0, ierr = 0;
+	void *p = NULL;
+	ORB_t t1, t2, t3;
+
+	/* the CPUs this rank may run on */
+	if (sched_getaffinity(0, sizeof(mask), &mask) != 0)
+		CPU_ZERO(&mask);
+	cpus = (int *)malloc(CPU_SETSIZE * sizeof(int));
+	assert(cpus != NULL);
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &mask))
+			cpus[ncpu++] = i;
+	if (ncpu < 2)
+		fprintf(stderr, "Rank %d: only %d CPU(s) in the affinity mask, no core-to-core pairs\n", my_rank, ncpu);
+
+	ierr = posix_memalign(&p, CACHELINE, sizeof(c2c_line_t));
+	assert(ierr == 0);
+	line = (c2c_line_p)p;
+	cos = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for round trip timings */
+	assert(cos != NULL);
+	t = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for timer overhead timings */
+	assert(t != NULL);
+	med = (double *)calloc((size_t)ncpu * ncpu, sizeof(double));
+	min = (ORB_tick_t *)malloc((size_t)ncpu * ncpu * sizeof(ORB_tick_t));
+	assert((med != NULL) && (min != NULL));
+	for (i = 0; i < ncpu * ncpu; i++)
+		min[i] = ~((ORB_tick_t)0);
+	rounds = tst->num_warmup + tst->num_messages;
+
+	/* calibrate timer */
+	measurement_calibrate(tst);
+	comm_barrier();
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
+		for (a = 0; a < ncpu; a++) {
+			for (b = a + 1; b < ncpu; b++) {
+				/* ping from CPU a, answered from CPU b */
+				ierr += c2c_pin(cpus[a]);
+				line->flag = 0;
+				pong.line = line;
+				pong.cpu = cpus[b];
+				pong.rounds = rounds;
+				ierr += pthread_create(&tid, NULL, c2c_pong, &pong);
+				/* warm-up, and wait for the responder to be running */
+				for (r = 0; r < tst->num_warmup; r++) {
+					line->flag = 2 * (uint64_t)r + 1;
+					while (line->flag != 2 * (uint64_t)r + 2)
+						;
+				}
+				/************************************************************/
+				/* BEGIN PERFORMANCE KERNEL -- gather samples for this pair */
+				/************************************************************/
+				for (i = 0; i < tst->num_messages; i++, r++) {
+					/* for timer overhead estimate */
+					ORB_read(t1);
+					ORB_read(t2);
+					/* one round trip of the line */
+					line->flag = 2 * (uint64_t)r + 1;
+					while (line->flag != 2 * (uint64_t)r + 2)
+						;
+					ORB_read(t3);
+					t[i] = ORB_cycles(t2, t1);
+					cos[i] = ORB_cycles(t3, t2);
+				}
+				/************************************************************/
+				/* END PERFORMANCE KERNEL -- samples gathered for this pair */
+				/************************************************************/
+				ierr += pthread_join(tid, NULL);
+				assert(ierr == 0);
+
+				/* bin the samples, as all pairs and by placement class */
+				place = placement_cpu_distance(cpus[a], cpus[b]);
+				cmin = ~((ORB_tick_t)0);
+				for (i = 0; i < tst->num_messages; i++) {
+					if (TICK_VALID(t[i]))
+						MEASUREMENT_BIN(m, c2cTimer, tick2bin(tst,t[i]))++;
+					if (!TICK_VALID(cos[i]))
+						continue;
+					MEASUREMENT_BIN(m, roundTrip, tick2bin(tst,cos[i]))++;
+					if (place > PLACE_UNKNOWN)
+						MEASUREMENT_BIN(m, sameL3RoundTrip + place, tick2bin(tst,cos[i]))++;
+					if (cos[i] < cmin)
+						cmin = cos[i];
+				}
+				if (TICK_VALID(cmin)) {
+					MEASUREMENT_BIN(m, roundTripMinimum, tick2bin(tst,cmin))++;
+					if (cmin < min[a * ncpu + b])
+						min[a * ncpu + b] = min[b * ncpu + a] = cmin;
+				}
+				/* and keep the median for the matrix */
+				qsort(cos, tst->num_messages, sizeof(ORB_tick_t), c2c_cmp);
+				med[a * ncpu + b] += (double)cos[tst->num_messages / 2];
+				med[b * ncpu + a] = med[a * ncpu + b];
+			}
+		}
+		cycles++;
+		/* out of time? all ranks stop after the same cycle */
+		stop = comm_time_expired(tst);
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
+	}
+	/* back to the launcher's binding */
+	sched_setaffinity(0, sizeof(mask), &mask);
+
+	c2c_write(tst, m, cpus, ncpu, med, min, cycles);
+	free(min);
+	free(med);
+	free(t);
+	free(cos);
+	free(line);
+	free(cpus);
+	return;
+}
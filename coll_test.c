@@ -0,0 +1,316 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+/**
+ * \brief Times each invocation of the common collectives on every rank.
+ *
+ * Pros: 
+ * - Distributions of per-rank and slowest-rank collective latency
+ * - Exposes tail latency that dominates tightly coupled solvers
+ *
+ * Cons:
+ * - Per-rank times include the skew with which ranks enter each call
+ * - Alltoall requires buffers of buflen * num_ranks bytes
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "config.h"
+#include "orbtimer.h"
+#include "comm.h"
+#include "tests.h"
+#include "measurement.h"
+
+#ifdef SHMEM
+	#include <mpp/shmem.h>
+#else
+	#include <mpi.h>
+#endif
+
+/* number of collective latency histograms */
+#define COLL_LEN 9
+
+/* number of collectives timed */
+#define COLL_OPS 4
+
+/* histograms for collective latency measurements */
+enum coll_vars {
+	/* timer overhead */
+	collTimer,
+	/* per-rank time and slowest rank time for each collective */
+	barrier, barrierMax,
+	allreduce, allreduceMax,
+	bcast, bcastMax,
+	alltoall, alltoallMax
+};
+
+char *coll_labels[] = {
+	/* timer overhead */
+	"timer",
+	/* per-rank time and slowest rank time for each collective */
+	"barrier", "barrierMax",
+	"allreduce", "allreduceMax",
+	"bcast", "bcastMax",
+	"alltoall", "alltoallMax"
+};
+
+/* per-rank histogram of collective k, its slowest rank histogram follows */
+#define COLL_HIST(k) (barrier + 2 * (k))
+
+/**
+ \brief Create the measurement struct for the test
+ \param tst Will tell the test how many times to run
+ \param label A label for the measurement struct
+*/
+measurement_p coll_measurement_create(test_p tst, char *label) {
+	int i;
+	measurement_p m = measurement_real_create(tst, label, COLL_LEN);
+	for (i = 0; i < COLL_LEN; i++) {
+		strncpy(m->hist[i].label,coll_labels[i],LABEL_LEN);
+		/* adaptive sampling watches every collective */
+		m->hist[i].converge = (i != collTimer);
+	}
+	return m;
+}
+
+/**
+ \brief Times barrier, sum reduction, broadcast and all-to-all with SHMEM
+ \param tst Tells how many cycles and calls per cycle to run
+ \param m Collects measurement data from the test
+*/
+void coll_SHMEM_test(test_p tst, measurement_p m) {
+#ifdef SHMEM
+	/* alternate sync arrays so consecutive collectives need no extra barrier */
+#	define COLL_PSYNC_SIZE (_SHMEM_BCAST_SYNC_SIZE > _SHMEM_REDUCE_SYNC_SIZE ? \
+				 _SHMEM_BCAST_SYNC_SIZE : _SHMEM_REDUCE_SYNC_SIZE)
+	static long pSync[2][COLL_PSYNC_SIZE];
+	buffer_t *sbuf, *rbuf, *abuf, *bbuf;
+	ORB_tick_t *c, *cmax, *tmp, *t, *pWrk;
+	int i, k, p, icycle, count, max;
+	ORB_t t1, t2, t3;
+	/* reductions and broadcasts work on 8 byte elements */
+	count = (m->buflen < 8) ? 1 : (m->buflen / 8);
+	sbuf = tst->buf[0];
+	rbuf = tst->buf[1];
+	abuf = comm_newbuffer((size_t)m->buflen * num_ranks);	/* all-to-all buffers */
+	bbuf = comm_newbuffer((size_t)m->buflen * num_ranks);
+	max = (count/2 + 1) > _SHMEM_REDUCE_MIN_WRKDATA_SIZE ? (count/2 + 1) : _SHMEM_REDUCE_MIN_WRKDATA_SIZE;
+	pWrk = (ORB_tick_t *)shmalloc(max * sizeof(ORB_tick_t));
+	assert(pWrk != NULL);
+	c = (ORB_tick_t *)shmalloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for collective timings */
+	assert(c != NULL);
+	cmax = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for slowest rank timings */
+	assert(cmax != NULL);
+	tmp = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* another rank's timings */
+	assert(tmp != NULL);
+	t = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for timer overhead timings */
+	assert(t != NULL);
+	for (i = 0; i < COLL_PSYNC_SIZE; i++)
+		pSync[0][i] = pSync[1][i] = _SHMEM_SYNC_VALUE;
+	memset(sbuf->data, 0, (size_t)count * 8 > sbuf->len ? sbuf->len : (size_t)count * 8);
+
+	/* calibrate timer */
+	measurement_calibrate(tst);
+	shmem_barrier_all();
+	comm_time_start(tst);
+	for (icycle = 0; icycle < tst->num_cycles; icycle++) {
+		/* out of time? all ranks stop at the same cycle boundary */
+		if (comm_time_expired(tst))
+			break;
+		for (k = 0; k < COLL_OPS; k++) {
+			shmem_barrier_all();
+			for (i = -tst->num_warmup; i < tst->num_messages; i++) {
+				ORB_read(t1);
+				ORB_read(t2);
+				/*************************************/
+				/* begin timed collective            */
+				/*************************************/
+				switch (k) {
+					case 0:
+						shmem_barrier_all();
+						break;
+					case 1:
+						shmem_longlong_sum_to_all((long long *)rbuf->data, (long long *)sbuf->data,
+									  count, 0, 0, num_ranks, (long long *)pWrk, pSync[i & 1]);
+						break;
+					case 2:
+						shmem_broadcast64(rbuf->data, sbuf->data, count, root_rank,
+								  0, 0, num_ranks, pSync[i & 1]);
+						break;
+					case 3:
+						for (p = 1; p <= num_ranks; p++) {
+							int pe = (my_rank + p) % num_ranks;
+							shmem_putmem((char *)bbuf->data + (size_t)my_rank * m->buflen,
+								     (char *)abuf->data + (size_t)pe * m->buflen, m->buflen, pe);
+						}
+						shmem_barrier_all();
+						break;
+				}
+				/*************************************/
+				/* end timed collective              */
+				/*************************************/
+				ORB_read(t3);
+				if (i >= 0) {
+					t[i] = ORB_cycles(t2, t1);
+					c[i] = ORB_cycles(t3, t2);
+				}
+			}
+			/* slowest rank for each call, collected on root */
+			shmem_barrier_all();
+			ROOTONLY {
+				memcpy(cmax, c, tst->num_messages * sizeof(ORB_tick_t));
+				for (p = 0; p < num_ranks; p++) {
+					if (p == my_rank)
+						continue;
+					shmem_get64(tmp, c, tst->num_messages, p);
+					for (i = 0; i < tst->num_messages; i++)
+						if (tmp[i] > cmax[i])
+							cmax[i] = tmp[i];
+				}
+			}
+			/* root is done reading before c is overwritten */
+			shmem_barrier_all();
+			coll_measurement_bin(tst, m, k, t, c, (my_rank == root_rank) ? cmax : NULL);
+		}
+		/* confident enough in the watched quantiles? */
+		if (measurement_converged(tst, m))
+			break;
+	}
+
+	free(t);
+	free(tmp);
+	free(cmax);
+	shfree(c);
+	shfree(pWrk);
+	comm_freebuffer(bbuf);
+	comm_freebuffer(abuf);
+#endif
+	return;
+}
+
+/**
+ \brief Times MPI_Barrier, MPI_Allreduce, MPI_Bcast and MPI_Alltoall
+ \param tst Tells how many cycles and calls per cycle to run
+ \param m Collects measurement data from the test
+*/
+void coll_MPI_test(test_p tst, measurement_p m) {
+#ifndef SHMEM
+	buffer_t *sbuf, *rbuf, *abuf, *bbuf;
+	ORB_tick_t *c, *cmax, *t;
+	int i, k, icycle, ierr, count;
+	ORB_t t1, t2, t3;
+	/* reductions work on doubles */
+	count = (m->buflen < sizeof(double)) ? 1 : (m->buflen / sizeof(double));
+	sbuf = tst->buf[0];
+	rbuf = tst->buf[1];
+	abuf = comm_newbuffer((size_t)m->buflen * num_ranks);	/* all-to-all buffers */
+	bbuf = comm_newbuffer((size_t)m->buflen * num_ranks);
+	memset(sbuf->data, 0, sbuf->len);
+	c = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for collective timings */
+	assert(c != NULL);
+	cmax = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for slowest rank timings */
+	assert(cmax != NULL);
+	t = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for timer overhead timings */
+	assert(t != NULL);
+	/* calibrate timer */
+	measurement_calibrate(tst);
+	ierr = MPI_Barrier(MPI_COMM_WORLD);
+	comm_time_start(tst);
+	for (icycle = 0; icycle < tst->num_cycles; icycle++) {
+		/* out of time? all ranks stop at the same cycle boundary */
+		if (comm_time_expired(tst))
+			break;
+		for (k = 0; k < COLL_OPS; k++) {
+			ierr = MPI_Barrier(MPI_COMM_WORLD);
+			/* the first num_warmup calls are not recorded */
+			for (i = -tst->num_warmup; i < tst->num_messages; i++) {
+				ORB_read(t1);
+				ORB_read(t2);
+				/*************************************/
+				/* begin timed collective            */
+				/*************************************/
+				switch (k) {
+					case 0:
+						ierr += MPI_Barrier(MPI_COMM_WORLD);
+						break;
+					case 1:
+						ierr += MPI_Allreduce(sbuf->data, rbuf->data, count, MPI_DOUBLE,
+								      MPI_SUM, MPI_COMM_WORLD);
+						break;
+					case 2:
+						ierr += MPI_Bcast(sbuf->data, m->buflen, MPI_BYTE, root_rank,
+								  MPI_COMM_WORLD);
+						break;
+					case 3:
+						ierr += MPI_Alltoall(abuf->data, m->buflen, MPI_BYTE,
+								     bbuf->data, m->buflen, MPI_BYTE, MPI_COMM_WORLD);
+						break;
+				}
+				/*************************************/
+				/* end timed collective              */
+				/*************************************/
+				ORB_read(t3);
+				if (i >= 0) {
+					t[i] = ORB_cycles(t2, t1);
+					c[i] = ORB_cycles(t3, t2);
+				}
+			}
+			assert(ierr == 0);
+			/* slowest rank for each call */
+			ierr += MPI_Reduce(c, cmax, tst->num_messages, MPI_UNSIGNED_LONG_LONG, MPI_MAX,
+					   root_rank, MPI_COMM_WORLD);
+			assert(ierr == 0);
+			coll_measurement_bin(tst, m, k, t, c, (my_rank == root_rank) ? cmax : NULL);
+		}
+		/* confident enough in the watched quantiles? */
+		if (measurement_converged(tst, m))
+			break;
+	}
+	free(t);
+	free(cmax);
+	free(c);
+	comm_freebuffer(bbuf);
+	comm_freebuffer(abuf);
+#endif
+	return;
+}
+
+/**
+ \brief Converts the collective time measurements (in timer ticks) to bin
+ \param k Which collective was timed
+ \param cmax Slowest rank timings, binned only where given (on root_rank)
+*/
+void coll_measurement_bin(test_p tst, measurement_p m, int k, ORB_tick_t *t, ORB_tick_t *c, ORB_tick_t *cmax) {
+	int i;
+	for (i = 0; i < tst->num_messages; i++) {
+		if (TICK_VALID(t[i]))
+			MEASUREMENT_BIN(m, collTimer, tick2bin(tst,t[i]))++;
+		if (TICK_VALID(c[i]))
+			MEASUREMENT_BIN(m, COLL_HIST(k), tick2bin(tst,c[i]))++;
+		if ((cmax != NULL) && TICK_VALID(cmax[i]))
+			MEASUREMENT_BIN(m, COLL_HIST(k) + 1, tick2bin(tst,cmax[i]))++;
+	}
+}
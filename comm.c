@@ -26,10 +26,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <ctype.h>
+#include <sys/time.h>
 
 #include "config.h"
 #include "orbtimer.h"
 #include "comm.h"
+#include "tests.h"
+#include "options.h"
 
 #ifdef SHMEM
 	#include <mpp/shmem.h>
@@ -87,21 +90,52 @@ void comm_freebuffer(buffer_p buf) {
 }
 
 /**
- * \brief Allocates space for the dist array  
+ * \brief Creates the exchange buffers shared by all message sizes of a run
+ * \param tst Gives the message sizes; the buffers are sized for the largest
+ */
+void comm_newbuffers(test_p tst) {
+	int i, maxlen = 1;
+	for (i = 0; i < tst->num_buf_lens; i++)
+		if (tst->buf_lens[i] > maxlen)
+			maxlen = tst->buf_lens[i];
+	/* the memory test's sizes are working sets, it maps its own */
+	if (tst->test_type == MEM_TEST)
+		maxlen = 1;
+	for (i = 0; i < TEST_BUFFERS; i++)
+		tst->buf[i] = comm_newbuffer((size_t)maxlen);
+	return;
+}
+
+/**
+ * \brief Frees the exchange buffers
+ * \sa comm_newbuffers
+ */
+void comm_freebuffers(test_p tst) {
+	int i;
+	for (i = 0; i < TEST_BUFFERS; i++) {
+		comm_freebuffer(tst->buf[i]);
+		tst->buf[i] = NULL;
+	}
+	return;
+}
+
+/**
+ * \brief Allocates zeroed, cache-line aligned space for the dist array
  * \param num_bins The size of the dist array
  */
 uint64_t *comm_alloc_dist(size_t num_bins) {
 	uint64_t *dist_array;
 #ifdef SHMEM
-	int i;
-	dist_array = (uint64_t *) shmalloc(num_bins * sizeof(uint64_t));
+	dist_array = (uint64_t *) shmemalign(CACHELINE, num_bins * sizeof(uint64_t));
 	assert(dist_array != NULL);
-	for (i = 0; i < num_bins; i++) {
-		dist_array[i] = 0x0;
-	}
 #else	/* MPI */
-	dist_array = (uint64_t *) calloc(num_bins, sizeof(uint64_t));
+	void *p = NULL;
+	if (posix_memalign(&p, CACHELINE, num_bins * sizeof(uint64_t)) != 0)
+		p = NULL;
+	dist_array = (uint64_t *)p;
+	assert(dist_array != NULL);
 #endif
+	memset(dist_array, 0, num_bins * sizeof(uint64_t));
 	return dist_array;
 }
 
@@ -118,35 +152,169 @@ void comm_free_dist(uint64_t *dist_array) {
 #endif
 }
 
+#ifndef SHMEM
+/* first word of a packed arena that is sent whole (see comm_pack) */
+#define COMM_DENSE UINT64_MAX
+/* message tag of the aggregation tree, clear of the net test's thread tags */
+#define COMM_AGGREGATE_TAG 1000
+/* the packed tree is used when no rank has more than 1/COMM_SPARSE of its
+ * counters set, leaving room for the sums to fill in up the tree */
+#define COMM_SPARSE 4
+
+/**
+ * \brief Packs an arena of counters for sending
+ * \param dist The counters
+ * \param count Number of counters
+ * \param buf Filled with the packed arena, room for count + 1 words
+ * \return Number of words in buf
+ *
+ * With log binning most bins are empty, so the non-zero counters are
+ * sent as (index, value) pairs after their number. When that is not
+ * smaller, COMM_DENSE is followed by all the counters.
+ */
+static size_t comm_pack(uint64_t *dist, size_t count, uint64_t *buf) {
+	size_t i, nnz = 0;
+	for (i = 0; i < count; i++)
+		if (dist[i] != 0)
+			nnz++;
+	if (2 * nnz >= count) {
+		buf[0] = COMM_DENSE;
+		memcpy(buf + 1, dist, count * sizeof(uint64_t));
+		return count + 1;
+	}
+	buf[0] = nnz;
+	for (i = 0, nnz = 0; i < count; i++) {
+		if (dist[i] != 0) {
+			buf[1 + 2 * nnz] = i;
+			buf[2 + 2 * nnz] = dist[i];
+			nnz++;
+		}
+	}
+	return 2 * nnz + 1;
+}
+
+/**
+ * \brief Adds a packed arena (comm_pack) into the counters
+ */
+static void comm_unpack_add(uint64_t *dist, size_t count, uint64_t *buf) {
+	size_t i;
+	if (buf[0] == COMM_DENSE) {
+		for (i = 0; i < count; i++)
+			dist[i] += buf[1 + i];
+		return;
+	}
+	for (i = 0; i < buf[0]; i++) {
+		assert(buf[1 + 2 * i] < count);
+		dist[buf[1 + 2 * i]] += buf[2 + 2 * i];
+	}
+}
+
+/**
+ * \brief Sums the arenas of all ranks on root_rank over a binomial tree,
+ * sending each partial sum packed (comm_pack)
+ * \param buf Room for count + 1 words
+ * \return 1 on root_rank, which holds the sum in gdist, else 0
+ */
+static int comm_reduce_packed(uint64_t *gdist, uint64_t *ldist, size_t count, uint64_t *buf) {
+	int mask, rel, peer, words, ierr = 0;
+	MPI_Status mpistatus;
+	memcpy(gdist, ldist, count * sizeof(uint64_t));
+	rel = (my_rank - root_rank + num_ranks) % num_ranks;
+	for (mask = 1; mask < num_ranks; mask <<= 1) {
+		if (rel & mask) {
+			/* pass the subtree's sum up and drop out */
+			peer = (rel - mask + root_rank) % num_ranks;
+			words = (int)comm_pack(gdist, count, buf);
+			ierr += MPI_Send(buf, words, MPI_UNSIGNED_LONG_LONG, peer, COMM_AGGREGATE_TAG, MPI_COMM_WORLD);
+			assert(ierr == 0);
+			return 0;
+		}
+		if (rel + mask < num_ranks) {
+			peer = (rel + mask + root_rank) % num_ranks;
+			ierr += MPI_Recv(buf, (int)count + 1, MPI_UNSIGNED_LONG_LONG, peer, COMM_AGGREGATE_TAG,
+					 MPI_COMM_WORLD, &mpistatus);
+			comm_unpack_add(gdist, count, buf);
+		}
+	}
+	assert(ierr == 0);
+	return 1;
+}
+#endif
+
 /**
  * \brief Collects the measurements into a global location
+ * \param tst Tells whether only root_rank needs the result
  * \param g The global array of measurements collected over the course of the run
  * \param l The local array of measurements
+ *
+ * All histograms of a measurement share one arena (see measurement_real_create),
+ * so the whole measurement is aggregated with a single reduction. With MPI
+ * a dense arena on any rank (eg. linear binning) takes MPI_Reduce or
+ * MPI_Allreduce; when every rank's arena is sparse, the reduction runs over
+ * a binomial tree and the broadcast of the result follows it, both sending
+ * only the non-empty bins when that is smaller.
  */
-void comm_aggregate(measurement_p g, measurement_p l) {
+void comm_aggregate(test_p tst, measurement_p g, measurement_p l) {
 	/* collects local measurments into a global measurement */
-	int i, ierr;
+	int ierr;
+	size_t count;
 	assert(l->nbins == g->nbins);
 	assert(l->num_histograms == g->num_histograms);
+	assert(l->dist_len == g->dist_len);
+	count = l->dist_len;
+	if (count == 0)
+		return;
 	ierr = 0;
 #ifdef SHMEM
-	int max = (l->nbins/2 + 1) > _SHMEM_REDUCE_MIN_WRKDATA_SIZE ? (l->nbins/2 + 1) : _SHMEM_REDUCE_MIN_WRKDATA_SIZE;
-	uint64_t *pWrk = (uint64_t *)shmalloc(max * sizeof(uint64_t));
-	assert(pWrk != NULL);
-	
-	for (i = 0; i < l->num_histograms; i++) {
-		shmem_barrier_all();
-		shmem_longlong_sum_to_all((long long *)g->hist[i].dist, (long long *)l->hist[i].dist,
-					  l->nbins, 0, 0, num_ranks, (long long *)pWrk, rSync);
+	/* work array is symmetric, keep it between calls and only grow it */
+	static uint64_t *pWrk = NULL;
+	static size_t pWrk_len = 0;
+	size_t max = (count/2 + 1) > _SHMEM_REDUCE_MIN_WRKDATA_SIZE ? (count/2 + 1) : _SHMEM_REDUCE_MIN_WRKDATA_SIZE;
+	if (max > pWrk_len) {
+		if (pWrk != NULL)
+			shfree(pWrk);
+		pWrk = (uint64_t *)shmalloc(max * sizeof(uint64_t));
+		assert(pWrk != NULL);
+		pWrk_len = max;
 	}
 	
+	/* SHMEM has no reduce-to-root, so tst->reduce_root is ignored here */
 	shmem_barrier_all();
-	shfree(pWrk);
+	shmem_longlong_sum_to_all((long long *)g->dist, (long long *)l->dist,
+				  count, 0, 0, num_ranks, (long long *)pWrk, rSync);
 #else				/* MPI case */
-	for (i = 0; i < l->num_histograms; i++) {
-		ierr += MPI_Allreduce(l->hist[i].dist, g->hist[i].dist, l->nbins,
-				MPI_INTEGER8, MPI_SUM, MPI_COMM_WORLD);
+	uint64_t *buf, words, nnz = 0, maxnnz;
+	size_t i;
+	/* dense anywhere (eg. linear binning): the library's tuned collectives */
+	for (i = 0; i < count; i++)
+		if (l->dist[i] != 0)
+			nnz++;
+	ierr += MPI_Allreduce(&nnz, &maxnnz, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, MPI_COMM_WORLD);
+	if (COMM_SPARSE * maxnnz >= count) {
+		if (tst->reduce_root)
+			ierr += MPI_Reduce(l->dist, g->dist, (int)count, MPI_UNSIGNED_LONG_LONG, MPI_SUM, root_rank, MPI_COMM_WORLD);
+		else
+			ierr += MPI_Allreduce(l->dist, g->dist, (int)count, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+		if (tst->reduce_root && (my_rank != root_rank))
+			memset(g->dist, 0, count * sizeof(uint64_t));
+		assert(ierr == 0);
+		return;
 	}
+	/* sparse everywhere: a binomial tree of packed partial sums */
+	buf = (uint64_t *)malloc((count + 1) * sizeof(uint64_t));	/* a packed arena */
+	assert(buf != NULL);
+	if (!comm_reduce_packed(g->dist, l->dist, count, buf))
+		memset(g->dist, 0, count * sizeof(uint64_t));
+	if (!tst->reduce_root) {
+		/* every rank analyzes the global result: broadcast it, packed */
+		ROOTONLY words = comm_pack(g->dist, count, buf);
+		ierr += MPI_Bcast(&words, 1, MPI_UNSIGNED_LONG_LONG, root_rank, MPI_COMM_WORLD);
+		ierr += MPI_Bcast(buf, (int)words, MPI_UNSIGNED_LONG_LONG, root_rank, MPI_COMM_WORLD);
+		if (my_rank != root_rank)
+			comm_unpack_add(g->dist, count, buf);
+	}
+	/* otherwise only root_rank analyzes and serializes the global result */
+	free(buf);
 
 	assert(ierr == 0);
 #endif
@@ -175,6 +343,32 @@ void comm_showmapping(test_p tst) {
 	return;
 }
 
+/**
+ * \brief Turns a node name into a node id: the number formed by its digits
+ * \param name Node name, eg. a hostname like 'nid00012'
+ * \return id The node id (12 in the example)
+ */
+uint64_t comm_name2nodeid(char *name) {
+	char *pn, *pp;
+	uint64_t id;
+	int ierr = 0;
+	pp = name - 1;
+	pn = nid;
+	/* copy all (and only) the digits to a new buffer */
+	while (++pp < name + strlen(name))
+		if (isdigit(*pp) && (pn < nid + NAMEBUFFSIZE - 1))
+			*pn++ = *pp;
+	*pn = (char)0;
+	errno = 0;
+	id = strtoull(nid, NULL, 10);
+	ierr = errno;
+	if (ierr == ERANGE || ierr == EINVAL) {
+		perror("strtol");
+		exit(ierr);
+	}
+	return id;
+}
+
 /**
  * \brief Gives the value of the calling node
  * \return id Is the ID of the node
@@ -193,14 +387,13 @@ uint64_t comm_getnodeid() {
 	 */
 	uint64_t id;
 #if defined(NODEID_GETHOSTNAME) || defined(NODEID_MPI) || defined(NODEID_SLURM)
-	char *pn, *pp, *limit;
-	int  ierr = 0;
 #    if defined(SHMEM)
 	gethostname(namebuff, NAMEBUFFSIZE);
 	nodename = namebuff;
 #    elif defined(NODEID_MPI)
-	int len = NAMEBUFFSIZE;
+	int ierr, len = NAMEBUFFSIZE;
 	ierr = MPI_Get_processor_name(namebuff, &len);
+	assert(ierr == 0);
 	nodename = namebuff;
 #    elif defined(NODEID_GETHOSTNAME)
 	gethostname(namebuff, NAMEBUFFSIZE);
@@ -208,21 +401,7 @@ uint64_t comm_getnodeid() {
 #    elif defined(NODEID_SLURM)
 	nodename = getenv("SLURM_NODEID");
 #    endif
-	limit = nodename + strlen(nodename);
-	pp = nodename - 1;
-	pn = nid;
-	/* copy all (and only) the digits to a new buffer */
-	while (++pp < nodename + strlen(nodename))
-		if (isdigit(*pp))
-			*pn++ = *pp;
-	*pn = (char)0;
-	errno = 0;
-	id = strtoull(nid, NULL, 10);
-	ierr = errno;
-	if (ierr == ERANGE || ierr == EINVAL) {
-		perror("strtol");
-		exit(ierr);
-	}
+	id = comm_name2nodeid(nodename);
 #else			/* NODEID_<TYPE> not defined. Punt. One MPI rank per node. */
 	int tmp;
 #    ifdef SHMEM
@@ -249,6 +428,267 @@ int comm_ceil2(int n) {
 	return c;
 }
 
+/**
+ * \brief Returns the number of stages in one pass of the all-pairs schedule
+ * \param tst Tells which schedule is in use
+ * \return number of stages
+ *
+ * The XOR schedule needs the next power of 2 stages, leaving ranks idle in
+ * the upper stages when num_ranks is not a power of 2. The round-robin
+ * (circle method) schedule pairs every rank in every stage: num_ranks-1
+ * stages for an even number of ranks, num_ranks stages (one idle rank per
+ * stage) for an odd number.
+ */
+int comm_num_stages(test_p tst) {
+	if (tst->schedule == SCHED_ROUNDROBIN)
+		return (num_ranks % 2 == 0) ? (num_ranks - 1) : num_ranks;
+	return comm_ceil2(num_ranks);
+}
+
+/**
+ * \brief Returns this rank's partner for a stage of the all-pairs schedule
+ * \param tst Tells which schedule is in use
+ * \param stage The stage number, 0 <= stage < comm_num_stages(tst)
+ * \return partner rank, or -1 if this rank sits out the stage
+ */
+int comm_partner(test_p tst, int stage) {
+	int n, p;
+	if (tst->schedule == SCHED_ROUNDROBIN) {
+		/* pad odd rank counts with a dummy; its partner sits out */
+		n = num_ranks + (num_ranks % 2);
+		if (my_rank == n - 1) {
+			p = stage;
+		} else {
+			/* ranks 0..n-2 rotate around the fixed rank n-1 */
+			p = (2 * stage - my_rank) % (n - 1);
+			if (p < 0)
+				p += n - 1;
+			if (p == my_rank)
+				p = n - 1;
+		}
+	} else {
+		p = my_rank ^ stage;
+	}
+	if ((p < 0) || (p >= num_ranks) || (p == my_rank))
+		return -1;
+	return p;
+}
+
+/* wall clock time at which the current time-limited collection began */
+static double comm_time_zero = 0.0;
+
+/**
+ * \brief Wall clock time in seconds
+ */
+static double comm_wtime() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return ((double)tv.tv_sec) + ((double)tv.tv_usec) / 1.0e+6;
+}
+
+/**
+ * \brief Starts the clock for a time-limited collection
+ * \param tst Holds the time limit
+ */
+void comm_time_start(test_p tst) {
+	comm_time_zero = comm_wtime();
+	return;
+}
+
+/**
+ * \brief Gives every rank the value of a flag decided on root_rank
+ * \param flag The decision; only root_rank's value is used
+ * \return root_rank's flag, on every rank
+ */
+int comm_root_flag(int flag) {
+#ifdef SHMEM
+	static int root_flag = 0;
+	ROOTONLY root_flag = flag;
+	shmem_barrier_all();
+	flag = shmem_int_g(&root_flag, root_rank);
+	/* root may not update the flag until everyone has read it */
+	shmem_barrier_all();
+#else	/* MPI */
+	int ierr;
+	ierr = MPI_Bcast(&flag, 1, MPI_INT, root_rank, MPI_COMM_WORLD);
+	assert(ierr == 0);
+#endif
+	return flag;
+}
+
+/**
+ * \brief Copies root_rank's array to every rank
+ * \param buf Array of count 64-bit words; need not be symmetric for SHMEM
+ * \param count Number of words
+ */
+void comm_broadcast64(uint64_t *buf, size_t count) {
+	if (count == 0)
+		return;
+#ifdef SHMEM
+	uint64_t *sym = (uint64_t *)shmalloc(count * sizeof(uint64_t));
+	assert(sym != NULL);
+	ROOTONLY memcpy(sym, buf, count * sizeof(uint64_t));
+	shmem_barrier_all();
+	if (my_rank != root_rank)
+		shmem_get64(buf, sym, count, root_rank);
+	shmem_barrier_all();
+	shfree(sym);
+#else	/* MPI */
+	int ierr;
+	ierr = MPI_Bcast(buf, count, MPI_UNSIGNED_LONG_LONG, root_rank, MPI_COMM_WORLD);
+	assert(ierr == 0);
+#endif
+	return;
+}
+
+/**
+ * \brief Gives every rank the slices of all ranks
+ * \param buf Array of num_ranks slices of count 64-bit words, this rank's
+ * slice filled in; need not be symmetric for SHMEM
+ * \param count Words per slice
+ */
+void comm_allgather64(uint64_t *buf, size_t count) {
+	if (count == 0)
+		return;
+#ifdef SHMEM
+	int r;
+	uint64_t *sym = (uint64_t *)shmalloc(num_ranks * count * sizeof(uint64_t));
+	assert(sym != NULL);
+	memcpy(sym + my_rank * count, buf + my_rank * count, count * sizeof(uint64_t));
+	shmem_barrier_all();
+	for (r = 0; r < num_ranks; r++)
+		if (r != my_rank)
+			shmem_get64(buf + r * count, sym + r * count, count, r);
+	shmem_barrier_all();
+	shfree(sym);
+#else	/* MPI */
+	int ierr;
+	ierr = MPI_Allgather(MPI_IN_PLACE, count, MPI_UNSIGNED_LONG_LONG,
+			     buf, count, MPI_UNSIGNED_LONG_LONG, MPI_COMM_WORLD);
+	assert(ierr == 0);
+#endif
+	return;
+}
+
+/**
+ * \brief Copies root_rank's array of doubles to every rank
+ * \param buf Array of count doubles; need not be symmetric for SHMEM
+ * \param count Number of doubles
+ */
+void comm_broadcast_double(double *buf, size_t count) {
+	if (count == 0)
+		return;
+#ifdef SHMEM
+	double *sym = (double *)shmalloc(count * sizeof(double));
+	assert(sym != NULL);
+	ROOTONLY memcpy(sym, buf, count * sizeof(double));
+	shmem_barrier_all();
+	if (my_rank != root_rank)
+		shmem_double_get(buf, sym, count, root_rank);
+	shmem_barrier_all();
+	shfree(sym);
+#else	/* MPI */
+	int ierr;
+	ierr = MPI_Bcast(buf, count, MPI_DOUBLE, root_rank, MPI_COMM_WORLD);
+	assert(ierr == 0);
+#endif
+	return;
+}
+
+/**
+ * \brief Gives every rank the doubles of all ranks
+ * \param buf Array of num_ranks slices of count doubles, this rank's slice
+ * filled in; need not be symmetric for SHMEM
+ * \param count Doubles per slice
+ */
+void comm_allgather_double(double *buf, size_t count) {
+	if (count == 0)
+		return;
+#ifdef SHMEM
+	int r;
+	double *sym = (double *)shmalloc(num_ranks * count * sizeof(double));
+	assert(sym != NULL);
+	memcpy(sym + my_rank * count, buf + my_rank * count, count * sizeof(double));
+	shmem_barrier_all();
+	for (r = 0; r < num_ranks; r++)
+		if (r != my_rank)
+			shmem_double_get(buf + r * count, sym + r * count, count, r);
+	shmem_barrier_all();
+	shfree(sym);
+#else	/* MPI */
+	int ierr;
+	ierr = MPI_Allgather(MPI_IN_PLACE, count, MPI_DOUBLE,
+			     buf, count, MPI_DOUBLE, MPI_COMM_WORLD);
+	assert(ierr == 0);
+#endif
+	return;
+}
+
+/**
+ * \brief Waits for every rank
+ */
+void comm_barrier() {
+#ifdef SHMEM
+	shmem_barrier_all();
+#else	/* MPI */
+	int ierr;
+	ierr = MPI_Barrier(MPI_COMM_WORLD);
+	assert(ierr == 0);
+#endif
+	return;
+}
+
+/**
+ * \brief Copies a row of 64-bit words from a rank to root_rank
+ * \param dst Where root_rank stores the row
+ * \param row The row on its owner; symmetric (comm_alloc_dist) for SHMEM
+ * \param count Number of words
+ * \param rank Owner of the row
+ *
+ * Every rank calls this for the same sequence of owners. With SHMEM the
+ * sequence must be bracketed by comm_barrier(), so the rows are complete
+ * before root reads them and are not freed before root is done.
+ */
+void comm_fetch_row(uint64_t *dst, uint64_t *row, size_t count, int rank) {
+	if (my_rank == root_rank) {
+		if (rank == root_rank) {
+			memcpy(dst, row, count * sizeof(uint64_t));
+			return;
+		}
+#ifdef SHMEM
+		shmem_get64(dst, row, count, rank);
+#else	/* MPI */
+		int ierr;
+		MPI_Status mpistatus;
+		ierr = MPI_Recv(dst, count, MPI_UNSIGNED_LONG_LONG, rank, 0, MPI_COMM_WORLD, &mpistatus);
+		assert(ierr == 0);
+#endif
+	} else if (my_rank == rank) {
+#ifndef SHMEM
+		int ierr;
+		ierr = MPI_Send(row, count, MPI_UNSIGNED_LONG_LONG, root_rank, 0, MPI_COMM_WORLD);
+		assert(ierr == 0);
+#endif
+	}
+	return;
+}
+
+/**
+ * \brief Collectively decides whether the collection time limit is spent
+ * \param tst Holds the time limit; with no limit this returns 0 without communicating
+ * \return 1 on every rank once root_rank has seen the limit pass, 0 otherwise
+ *
+ * Only root_rank reads the clock, so every rank stops at the same
+ * stage (or cycle) boundary and no pair block is cut short.
+ */
+int comm_time_expired(test_p tst) {
+	int stop = 0;
+	if (tst->time_limit <= 0.0)
+		return 0;
+	ROOTONLY stop = ((comm_wtime() - comm_time_zero) > tst->time_limit);
+	return comm_root_flag(stop);
+}
+
 /** 
  * \brief Initializes the communication arrays - SHMEM
  * \param tst Will tell the test how many stages it should run
@@ -261,6 +701,7 @@ void comm_SHMEM_initialize(test_p tst, int *argc, char **argv[]) {
 	int i;
 	
 	start_pes(0);
+	thread_multiple = 0;	/* the threaded net test is MPI only */
 	my_rank = _my_pe();
 	num_ranks = _num_pes();
 	
@@ -269,6 +710,8 @@ void comm_SHMEM_initialize(test_p tst, int *argc, char **argv[]) {
 	node_id = (uint64_t *)shmalloc(num_ranks * sizeof(uint64_t));
 	assert(node_id != NULL);
 	for ( i=0; i<num_ranks; i++) node_id[i] = 0;
+	rank_freq = (double *)calloc(num_ranks, sizeof(double));
+	assert(rank_freq != NULL);
 	
 	/* sync arrays for collectives */
 	for (i = 0; i < _SHMEM_COLLECT_SYNC_SIZE; i++) cSync[i] = _SHMEM_SYNC_VALUE;
@@ -297,6 +740,7 @@ void comm_SHMEM_initialize(test_p tst, int *argc, char **argv[]) {
 void comm_SHMEM_finalize() {
 #ifdef SHMEM
 	shfree(node_id);
+	free(rank_freq);
 #endif
 	/* SHMEM requires no finalize function */
 	return;
@@ -311,9 +755,24 @@ void comm_SHMEM_finalize() {
 void comm_MPI_initialize(test_p tst, int *argc, char **argv[]) {
 #ifndef SHMEM
 	uint64_t mynodeid;
-	int ierr = 0;
+	int required, provided, ierr = 0;
 
-	ierr += MPI_Init(argc, argv);
+	/*
+	 * options are parsed after MPI is up, so look ahead for -p and -O:
+	 * only the threaded net test pays for MPI_THREAD_MULTIPLE, and the
+	 * trace writer thread (which makes no MPI calls) needs FUNNELED.
+	 */
+	required = MPI_THREAD_SINGLE;
+	if (option_given(*argc, *argv, 'O'))
+		required = MPI_THREAD_FUNNELED;
+	if (option_given(*argc, *argv, 'p'))
+		required = MPI_THREAD_MULTIPLE;
+	provided = MPI_THREAD_SINGLE;
+	if (required != MPI_THREAD_SINGLE)
+		ierr += MPI_Init_thread(argc, argv, required, &provided);
+	else
+		ierr += MPI_Init(argc, argv);
+	thread_multiple = (provided == MPI_THREAD_MULTIPLE);
 	ierr += MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
 	ierr += MPI_Comm_size(MPI_COMM_WORLD, &num_ranks);
 
@@ -321,6 +780,8 @@ void comm_MPI_initialize(test_p tst, int *argc, char **argv[]) {
 	tst->num_stages = comm_ceil2(num_ranks);
 	node_id = (uint64_t *)malloc(num_ranks * sizeof(uint64_t));
 	assert(node_id != NULL);
+	rank_freq = (double *)calloc(num_ranks, sizeof(double));
+	assert(rank_freq != NULL);
 
 	node_id[my_rank] = mynodeid = comm_getnodeid();
 	ierr += MPI_Allgather(&mynodeid, sizeof(uint64_t), MPI_BYTE,
@@ -337,6 +798,7 @@ void comm_MPI_initialize(test_p tst, int *argc, char **argv[]) {
 void comm_MPI_finalize() {
 #ifndef SHMEM
 	free(node_id);
+	free(rank_freq);
 	MPI_Finalize();
 #endif
 	return;
@@ -26,17 +26,34 @@
 #define HAVE_COMM_H
 
 
+/* all-pairs schedules */
+enum {SCHED_XOR=0, SCHED_ROUNDROBIN=1};
+
 /**************************************************************
  * FUNCTION PROTOTYPES
  **************************************************************/
 buffer_p comm_newbuffer(size_t nbytes);
 void comm_freebuffer(buffer_p buf);
+void comm_newbuffers(test_p tst);
+void comm_freebuffers(test_p tst);
 uint64_t *comm_alloc_dist(size_t num_bins);
 void comm_free_dist(uint64_t *dist_array);
-void comm_aggregate(measurement_p g, measurement_p l);
+void comm_aggregate(test_p tst, measurement_p g, measurement_p l);
 void comm_showmapping(test_p tst);
 uint64_t comm_getnodeid();
+uint64_t comm_name2nodeid(char *name);
 int comm_ceil2(int n);
+int comm_num_stages(test_p tst);
+int comm_partner(test_p tst, int stage);
+void comm_time_start(test_p tst);
+int comm_time_expired(test_p tst);
+int comm_root_flag(int flag);
+void comm_broadcast64(uint64_t *buf, size_t count);
+void comm_allgather64(uint64_t *buf, size_t count);
+void comm_broadcast_double(double *buf, size_t count);
+void comm_allgather_double(double *buf, size_t count);
+void comm_barrier();
+void comm_fetch_row(uint64_t *dst, uint64_t *row, size_t count, int rank);
 
 /* generic interface to MPI/SHMEM initialize and finalize */
 #ifdef SHMEM
@@ -62,9 +79,11 @@ int my_rank;
 int root_rank;
 int num_ranks;
 uint64_t *node_id;
+double *rank_freq;	/* timer frequency of every rank, set by measurement_calibrate() */
 char *nodename;
 char namebuff[NAMEBUFFSIZE];
 char nid[NAMEBUFFSIZE];
+int thread_multiple;	/* MPI_THREAD_MULTIPLE was provided (threaded net test) */
 
 #define ROOTONLY   if(my_rank == root_rank)
 
@@ -0,0 +1,202 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+/**
+ * \brief Fixed work quantum (FWQ) operating system noise test: every rank
+ * repeats a calibrated work loop and histograms how much longer than its
+ * fastest quantum each one took.
+ *
+ * Pros: 
+ * - Measures OS noise (interrupts, daemons, preemption) directly, in the
+ *   same output format as the latency tests
+ * - Needs no communication inside the kernel
+ *
+ * Cons:
+ * - Detours shorter than the quantum-to-quantum jitter of the loop itself
+ *   are not resolved
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "config.h"
+#include "orbtimer.h"
+#include "comm.h"
+#include "tests.h"
+#include "measurement.h"
+
+/* number of FWQ histograms */
+#define FWQ_LEN 4
+
+/* histograms for FWQ measurements */
+enum fwq_vars {
+	/* timer overhead */
+	fwqTimer,
+	/* time of each quantum, and the fastest quantum of each rank and cycle */
+	quantum, quantumMinimum,
+	/* time of each quantum beyond the fastest of its rank and cycle */
+	detour
+};
+
+char *fwq_labels[] = {
+	/* timer overhead */
+	"timer",
+	"quantum", "quantumMinimum",
+	"detour"
+};
+
+/* calibration: repetitions of each trial, and the most doublings tried */
+#define FWQ_TRIALS 5
+#define FWQ_MAX_DOUBLINGS 40
+
+/**
+ \brief Create the measurement struct for the test
+ \param tst Will tell the test how many times to run
+ \param label A label for the measurement struct
+*/
+measurement_p fwq_measurement_create(test_p tst, char *label) {
+	int i;
+	measurement_p m = measurement_real_create(tst, label, FWQ_LEN);
+	for (i = 0; i < FWQ_LEN; i++)
+		strncpy(m->hist[i].label,fwq_labels[i],LABEL_LEN);
+	/* adaptive sampling watches the detours */
+	m->hist[detour].converge = 1;
+	return m;
+}
+
+/**
+ \brief The fixed work: a dependent integer recurrence the compiler can not drop
+ \param n Iterations
+*/
+static uint64_t fwq_work(uint64_t n) {
+	volatile uint64_t sink;
+	uint64_t i, x = 1;
+	for (i = 0; i < n; i++)
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+	sink = x;
+	return sink;
+}
+
+/**
+ \brief Finds the work loop iterations that take tst->fwq_quantum seconds on this rank
+ \return Iterations per quantum
+
+ Each trial keeps the fastest of FWQ_TRIALS runs, so noise during the
+ calibration makes the quantum shorter, never longer.
+*/
+static uint64_t fwq_calibrate(test_p tst) {
+	uint64_t n = 1;
+	double best, s;
+	int i, k;
+	ORB_t t1, t2;
+	for (k = 0; k < FWQ_MAX_DOUBLINGS; k++, n *= 2) {
+		best = -1.0;
+		for (i = 0; i < FWQ_TRIALS; i++) {
+			ORB_read(t1);
+			fwq_work(n);
+			ORB_read(t2);
+			s = (double)ORB_cycles(t2, t1) / ORB_REFFREQ;
+			if ((best < 0.0) || (s < best))
+				best = s;
+		}
+		/* long enough to scale linearly to the quantum */
+		if (best >= tst->fwq_quantum / 8.0)
+			return (uint64_t)((double)n * tst->fwq_quantum / best) + 1;
+	}
+	return n;
+}
+
+/**
+ \brief Runs tst->num_messages fixed work quanta per cycle on every rank
+ \param tst Gives the quantum length, cycles, warmups and quanta per cycle
+ \param m Collects measurement data from the test
+
+ Ranks start each cycle together, so noise that hits many ranks at once
+ lines up in time as it would for a bulk synchronous code.
+*/
+void fwq_test(test_p tst, measurement_p m) {
+	ORB_tick_t *c, *t, cmin;
+	uint64_t work;
+	int i, icycle, stop = 0;
+	ORB_t t1, t2, t3;
+
+	c = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for quantum timings */
+	assert(c != NULL);
+	t = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for timer overhead timings */
+	assert(t != NULL);
+
+	/* calibrate timer, then the work of one quantum */
+	measurement_calibrate(tst);
+	work = fwq_calibrate(tst);
+	comm_barrier();
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
+		/* warm-up, and start the cycle together */
+		comm_barrier();
+		for (i = 0; i < tst->num_warmup; i++)
+			fwq_work(work);
+		/***************************************************************/
+		/* BEGIN PERFORMANCE KERNEL -- gather the quanta of this cycle */
+		/***************************************************************/
+		for (i = 0; i < tst->num_messages; i++) {
+			/* for timer overhead estimate */
+			ORB_read(t1);
+			ORB_read(t2);
+			fwq_work(work);
+			ORB_read(t3);
+			t[i] = ORB_cycles(t2, t1);
+			c[i] = ORB_cycles(t3, t2);
+		}
+		/***************************************************************/
+		/* END PERFORMANCE KERNEL -- quanta of this cycle gathered     */
+		/***************************************************************/
+
+		/* the fastest quantum is the noiseless baseline */
+		cmin = ~((ORB_tick_t)0);
+		for (i = 0; i < tst->num_messages; i++)
+			if (TICK_VALID(c[i]) && (c[i] < cmin))
+				cmin = c[i];
+		for (i = 0; i < tst->num_messages; i++) {
+			if (TICK_VALID(t[i]))
+				MEASUREMENT_BIN(m, fwqTimer, tick2bin(tst,t[i]))++;
+			if (!TICK_VALID(c[i]))
+				continue;
+			MEASUREMENT_BIN(m, quantum, tick2bin(tst,c[i]))++;
+			MEASUREMENT_BIN(m, detour, tick2bin(tst,c[i] - cmin))++;
+		}
+		if (TICK_VALID(cmin))
+			MEASUREMENT_BIN(m, quantumMinimum, tick2bin(tst,cmin))++;
+
+		/* out of time? all ranks stop after the same cycle */
+		stop = comm_time_expired(tst);
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
+	}
+	free(t);
+	free(c);
+	return;
+}
@@ -33,6 +33,7 @@
 #include "tests.h"
 #include "measurement.h"
 #include "xdd_main.h"
+#include "outlier.h"
 
 #ifdef SHMEM
 	#include <mpp/shmem.h>
@@ -117,6 +118,14 @@ void io_MPI_test(test_p tst, measurement_p m) {
 	/* length of ops in seconds */
 	double *disk_times;
 
+	/* every rank has a ring, even if its analysis ends early */
+	if (tst->outlier_threshold != 0.0)
+		m->outliers = outlier_create(tst);
+
+	/* calibrate timer (log-linear binning converts seconds back to ticks):
+	 * collective, so before any rank can return early */
+	measurement_calibrate(tst);
+
 	/* run xdd with provided arguments */
 	xdd_main(tst->argc, tst->argv);
 	/* if user passed a help option, no need for analysis */
@@ -168,6 +177,16 @@ void io_MPI_test(test_p tst, measurement_p m) {
 	/* bin the times */
 	io_measurement_bin(tst, m, disk_times);
 
+	/* log the slow operations, timed from the first one */
+	if (m->outliers != NULL) {
+		double *start_times = malloc(sizeof(double)*numents);
+		assert(start_times);
+		for (j = 0; j < numents; j++)
+			start_times[j] = pclk2sec((tsdata->tte[j].disk_start - tsdata->tte[0].disk_start),res);
+		outlier_seconds(tst, m->outliers, start_times, disk_times, numents, -1, 0, 0);
+		free(start_times);
+	}
+
 	free(disk_times);
 }
 
@@ -179,17 +198,12 @@ void io_MPI_test(test_p tst, measurement_p m) {
 */
 void io_measurement_bin(test_p tst, measurement_p m, double *dtimes) {
 	double dtmin = dtimes[0];
-	uint64_t *pop, *pmin;
 	int i;
 
-	/* dist arrays */
-	pop = m->hist[diskOp].dist;
-	pmin = m->hist[diskOpMinimum].dist;
-
 	for (i = 0; i < tst->num_messages; i++) {
 		if (dtimes[i] >= 0.0) {
 			/* bin the disk op */
-			pop[time2bin(tst,dtimes[i])]++;
+			MEASUREMENT_BIN(m, diskOp, time2bin(tst,dtimes[i]))++;
 			/* save the minimum */
 			if (dtimes[i] < dtmin)
 				dtmin = dtimes[i];
@@ -198,7 +212,7 @@ void io_measurement_bin(test_p tst, measurement_p m, double *dtimes) {
 
 	/* bin the min */
 	if (dtmin > 0.0)
-		pmin[time2bin(tst,dtmin)]++;
+		MEASUREMENT_BIN(m, diskOpMinimum, time2bin(tst,dtmin))++;
 }
 
 /*********************************************************
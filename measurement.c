@@ -31,15 +31,38 @@
 #include "copyright.h"
 #include "comm.h"
 #include "tests.h"
+#include "outlier.h"
+
+/**********************************************
+ * \brief Count leading zeros of a nonzero 64 bit value
+ **********************************************/
+#if defined(__GNUC__)
+#  define clz64(_X_) __builtin_clzll(_X_)
+#else
+static inline int clz64(ORB_tick_t x) {
+	int n = 0;
+	if ((x >> 32) == 0) { n += 32; x <<= 32; }
+	if ((x >> 48) == 0) { n += 16; x <<= 16; }
+	if ((x >> 56) == 0) { n +=  8; x <<=  8; }
+	if ((x >> 60) == 0) { n +=  4; x <<=  4; }
+	if ((x >> 62) == 0) { n +=  2; x <<=  2; }
+	if ((x >> 63) == 0) { n +=  1; }
+	return n;
+}
+#endif
 
 /**********************************************
  * \brief Convert a time (in seconds) to a bin number
  **********************************************/
 inline int time2bin(test_p tst, double t) {
 	int b;
+	/* LOG-LINEAR binning works on timer ticks */
+	if (tst->log_binning == BIN_LOGLINEAR) {
+		return tick2bin(tst, (t > 0.0) ? (ORB_tick_t)(t * ORB_REFFREQ) : 0);
+	}
 	if (t < tst->max_hist_time) {
 		/* LINEAR binning */
-		if (tst->log_binning == 0) {
+		if (tst->log_binning == BIN_LINEAR) {
 			b = (int)(t / tst->bin_size);
 		/* LOGARITHMIC BINNING */
 		} else {
@@ -54,6 +77,34 @@ inline int time2bin(test_p tst, double t) {
 	return b;
 }
 
+/**********************************************
+ * \brief Convert a timer tick count to a bin number
+ *
+ * Log-linear binning keeps 2^bits linear sub-buckets for each power
+ * of 2 ticks (values below 2^bits get one bin per tick), so the bin
+ * follows from the leading one bit without floating point or log().
+ * Other binning modes convert to seconds and use time2bin().
+ **********************************************/
+inline int tick2bin(test_p tst, ORB_tick_t c) {
+	int b, shift;
+	if (tst->log_binning != BIN_LOGLINEAR)
+		return time2bin(tst, ((double)c) / ORB_REFFREQ);
+	shift = (c >> tst->subbucket_bits) ? (63 - clz64(c) - tst->subbucket_bits) : 0;
+	b = (shift << tst->subbucket_bits) + (int)(c >> shift);
+	/* drop the big ones in the last bin */
+	return (b < tst->num_bins) ? b : (tst->num_bins - 1);
+}
+
+/**************************************************
+ * \brief Convert a log-linear bin to it's bottom tick count
+ **************************************************/
+inline ORB_tick_t bin2tick(test_p tst, int b) {
+	int shift = (b >> tst->subbucket_bits) - 1;
+	/* below 2^bits ticks there is one bin per tick */
+	if (shift < 0) return (ORB_tick_t)b;
+	return ((ORB_tick_t)(b - (shift << tst->subbucket_bits))) << shift;
+}
+
 /**************************************************
  * \brief Convert a bin to it's corresponding bottom time
  **************************************************/
@@ -62,8 +113,11 @@ inline double bin2time(test_p tst, int b) {
 	/* first bin is special... goes to zero */
 	if (b == 0) return 0.0;
 	/* LINEAR binning */
-	if (tst->log_binning == 0) {
+	if (tst->log_binning == BIN_LINEAR) {
 		t = tst->bin_size * ((double)b);
+	/* LOG-LINEAR binning */
+	} else if (tst->log_binning == BIN_LOGLINEAR) {
+		t = ((double)bin2tick(tst, b)) / ORB_REFFREQ;
 	/* LOGARITHMIC binning */
 	} else {
 		t = tst->bin_size * exp((((double)b) / tst->hist_scale));
@@ -77,8 +131,11 @@ inline double bin2time(test_p tst, int b) {
 inline double bin2midtime(test_p tst, int b) {
 	double t;
 	/* LINEAR binning */
-	if (tst->log_binning == 0) {
+	if (tst->log_binning == BIN_LINEAR) {
 		t = tst->bin_size * ((double)b + 0.5);
+	/* LOG-LINEAR binning */
+	} else if (tst->log_binning == BIN_LOGLINEAR) {
+		t = 0.5 * ((double)bin2tick(tst, b) + (double)bin2tick(tst, b + 1)) / ORB_REFFREQ;
 	/* LOGARITHMIC binning */
 	} else {
 		t = tst->bin_size * exp((((double)b + 0.5) / tst->hist_scale));
@@ -95,6 +152,12 @@ measurement_p measurement_create(test_p tst, char *label) {
 		default:
 		case NET_TEST:		return net_measurement_create(tst, label);
 		case BIT_TEST:		return bit_measurement_create(tst, label);
+		case WIN_TEST:		return win_measurement_create(tst, label);
+		case COLL_TEST:		return coll_measurement_create(tst, label);
+		case C2C_TEST:		return c2c_measurement_create(tst, label);
+		case FWQ_TEST:		return fwq_measurement_create(tst, label);
+		case MEM_TEST:		return mem_measurement_create(tst, label);
+		case TIMER_TEST:	return timer_measurement_create(tst, label);
 #ifdef USE_XDD
 		case IO_TEST:		return io_measurement_create(tst, label);
 #endif
@@ -115,10 +178,37 @@ measurement_p measurement_real_create(test_p tst, char *label, int histograms) {
 	m->hist = (histogram_p)malloc(sizeof(histogram_t)*histograms);
 	assert(m->hist != NULL);
 
-	/* alloc distribution arrays */
+	/*
+	 * one cache-line aligned arena holds the bins of all histograms, so
+	 * the measurement aggregates in one collective. histogram-major keeps
+	 * each histogram contiguous (padded to a cache line), bin-major keeps
+	 * the counters of all histograms for one bin together.
+	 */
+	m->layout = tst->hist_layout;
+	if (m->layout == LAYOUT_BINMAJOR) {
+		m->hstride = 1;
+		m->bstride = (size_t)histograms;
+	} else {
+		m->hstride = ((size_t)tst->num_bins * sizeof(uint64_t) + CACHELINE - 1)
+				/ CACHELINE * CACHELINE / sizeof(uint64_t);
+		m->bstride = 1;
+	}
+	m->dist_len = (m->layout == LAYOUT_BINMAJOR) ? ((size_t)tst->num_bins * (size_t)histograms)
+						    : (m->hstride * (size_t)histograms);
+	m->dist = NULL;
+	m->pairs = NULL;
+	m->oneway = NULL;
+	m->outliers = NULL;
+	if (m->dist_len > 0) {
+		m->dist = comm_alloc_dist(m->dist_len);
+		assert(m->dist != NULL);
+	}
 	for (i = 0; i < histograms; i++) {
-		m->hist[i].dist = comm_alloc_dist((size_t)tst->num_bins);
-		assert(m->hist[i].dist != NULL);
+		m->hist[i].dist = m->dist + (size_t)i * m->hstride;
+		m->hist[i].stride = m->bstride;
+		m->hist[i].bytes = 0.0;
+		m->hist[i].messages = 0.0;
+		m->hist[i].converge = 0;
 	}
 
 	/* copy vars */
@@ -135,15 +225,30 @@ measurement_p measurement_real_create(test_p tst, char *label, int histograms) {
  * \brief Destructor routine for MEASUREMENT
  **********************************************/
 measurement_p measurement_destroy(measurement_p m) {
-	int i;
-	for (i = 0; i < m->num_histograms; i++) {
-		comm_free_dist(m->hist[i].dist);
-	}
+	if (m->dist != NULL)
+		comm_free_dist(m->dist);
+	if (m->pairs != NULL)
+		comm_free_dist(m->pairs);
+	if (m->oneway != NULL)
+		comm_free_dist(m->oneway);
+	if (m->outliers != NULL)
+		m->outliers = outlier_destroy(m->outliers);
 	free(m->hist);
 	free(m);
 	return NULL;
 }
 
+/**********************************************
+ * \brief Adds the bins of src into dst, eg. thread-local histograms
+ * into a rank's before comm_aggregate(); both have the same histograms
+ **********************************************/
+void measurement_merge(measurement_p dst, measurement_p src) {
+	size_t i;
+	assert((dst->dist_len == src->dist_len) && (dst->layout == src->layout));
+	for (i = 0; i < dst->dist_len; i++)
+		dst->dist[i] += src->dist[i];
+}
+
 /**********************************************
  * \brief Select test based on tst->test_type
  **********************************************/
@@ -155,6 +260,24 @@ void measurement_collect(test_p tst, measurement_p m) {
 		case BIT_TEST:
 			bit_test(tst, m);
 			break;
+		case WIN_TEST:
+			win_test(tst, m);
+			break;
+		case COLL_TEST:
+			coll_test(tst, m);
+			break;
+		case C2C_TEST:
+			c2c_test(tst, m);
+			break;
+		case FWQ_TEST:
+			fwq_test(tst, m);
+			break;
+		case MEM_TEST:
+			mem_test(tst, m);
+			break;
+		case TIMER_TEST:
+			timer_test(tst, m);
+			break;
 #ifdef USE_XDD
 		case IO_TEST:
 			io_test(tst, m);
@@ -166,6 +289,57 @@ void measurement_collect(test_p tst, measurement_p m) {
 	}
 }
 
+/**********************************************
+ * \brief Orders doubles ascending
+ **********************************************/
+static int measurement_cmp_double(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/**********************************************
+ * \brief Calibrate the timer once per run
+ *
+ * Ranks on one node read the same timer, so a rank whose frequency is
+ * more than FREQ_TOL off the median of its node is reported and takes
+ * that median instead. Only the first rank of a node adds a measured
+ * frequency to the cache, and only one that passed. Collective; the
+ * frequencies of all ranks end up in rank_freq[].
+ **********************************************/
+void measurement_calibrate(test_p tst) {
+	int r, n, first = my_rank;
+	double *freq = rank_freq, *same, median;
+	if (tst->calibrated)
+		return;
+	ORB_cache_file = tst->cal_file;
+	ORB_calibrate();
+	same = (double *)malloc(num_ranks * sizeof(double));
+	assert(same != NULL);
+	freq[my_rank] = ORB_REFFREQ;
+	comm_allgather_double(freq, 1);
+	for (r = n = 0; r < num_ranks; r++) {
+		if (node_id[r] != node_id[my_rank])
+			continue;
+		if (r < first)
+			first = r;
+		same[n++] = freq[r];
+	}
+	qsort(same, n, sizeof(double), measurement_cmp_double);
+	median = (n % 2) ? same[n / 2] : 0.5 * (same[n / 2 - 1] + same[n / 2]);
+	if (fabs(ORB_REFFREQ - median) > FREQ_TOL * median) {
+		fprintf(stderr, "Rank %d: timer frequency %.10g Hz (%s) is off the node median, using %.10g Hz\n",
+			my_rank, ORB_REFFREQ, ORB_freq_source, median);
+		ORB_set_freq(median, "node median");
+	} else if (my_rank == first) {
+		ORB_cache_commit();
+	}
+	free(same);
+	/* with the frequencies that ranks took from their node */
+	freq[my_rank] = ORB_REFFREQ;
+	comm_allgather_double(freq, 1);
+	tst->calibrated = 1;
+}
+
 /**********************************************
  * \brief Compute the moments for a histogram
  **********************************************/
@@ -180,10 +354,10 @@ void measurement_moments(test_p tst, histogram_p h, double center, double *m1, d
 	if (h->nsamples != 0) {
 		for (i = 0; i < tst->num_bins; i++) {
 			x = bin2midtime(tst,i) - center;
-			*m1 += (h->dist)[i] * x;
-			*m2 += (h->dist)[i] * x * x;
-			*m3 += (h->dist)[i] * x * x * x;
-			*m4 += (h->dist)[i] * x * x * x * x;
+			*m1 += HIST_BIN(h,i) * x;
+			*m2 += HIST_BIN(h,i) * x * x;
+			*m3 += HIST_BIN(h,i) * x * x * x;
+			*m4 += HIST_BIN(h,i) * x * x * x * x;
 		}
 		*m1 /= h->nsamples;
 		*m2 /= h->nsamples;
@@ -196,11 +370,11 @@ void measurement_moments(test_p tst, histogram_p h, double center, double *m1, d
 /**********************************************
  * \brief Count the samples in a histogram
  **********************************************/
-uint64_t measurement_samplecount(uint64_t *dist, int nbins) {
+uint64_t measurement_samplecount(histogram_p h, int nbins) {
 	int i;
 	uint64_t nsamples = 0;
 	for (i = 0; i < nbins; i++) {
-		nsamples += dist[i];
+		nsamples += HIST_BIN(h,i);
 	}
 	return nsamples;
 }
@@ -213,20 +387,29 @@ void measurement_histogram(test_p tst, histogram_p h, double scale) {
 	double s;
 	int i, j;
 	uint64_t tmp = 0;
-	h->nsamples = measurement_samplecount(h->dist, tst->num_bins); /* samples */
+	h->nsamples = measurement_samplecount(h, tst->num_bins); /* samples */
+	/* nothing to analyze (eg. no on-node pairs, or not the root of a reduce) */
+	if (h->nsamples == 0) {
+		h->min0 = h->mod0 = h->med0 = h->max0 = 0.0;
+		h->mods = h->meds = h->maxs = 0.0;
+		h->m10 = h->m20 = h->m30 = h->m40 = 0.0;
+		h->m1m = h->m2m = h->m3m = h->m4m = 0.0;
+		h->m1s = h->m2s = h->m3s = h->m4s = 0.0;
+		return;
+	}
 	i = -1;
-	while ((h->dist)[++i] == 0) ;	/* minimum */
+	while (HIST_BIN(h,++i) == 0) ;	/* minimum */
 	h->min0 = bin2midtime(tst,i);
 	j = 0;
 	for (i = 0; i < tst->num_bins; i++)
-		if ((h->dist)[i] > (h->dist)[j])
+		if (HIST_BIN(h,i) > HIST_BIN(h,j))
 			j = i;		/* mode */
 	h->mod0 = bin2midtime(tst,j);
 	i = -1;
-	while ((tmp += (h->dist)[++i]) < (h->nsamples) / 2) ;	/* median */
+	while ((tmp += HIST_BIN(h,++i)) < (h->nsamples) / 2) ;	/* median */
 	h->med0 = bin2midtime(tst,i);
 	i = tst->num_bins;
-	while ((h->dist)[--i] == 0) ;	/* maximum */
+	while (HIST_BIN(h,--i) == 0) ;	/* maximum */
 	h->max0 = bin2midtime(tst,i);
 	/* compute moments */
 	measurement_moments(tst, h, 0.0, &(h->m10), &(h->m20), &(h->m30), &(h->m40));
@@ -256,6 +439,105 @@ void measurement_analyze(test_p tst, measurement_p m, double scale) {
 	}
 }
 
+/* normal quantile of the two-sided 95% confidence level */
+#define CI_Z 1.96
+
+/**********************************************
+ * \brief Find the bin holding the r-th smallest sample (from 0)
+ **********************************************/
+static int measurement_rankbin(test_p tst, histogram_p h, uint64_t r) {
+	int i;
+	uint64_t tmp = 0;
+	for (i = 0; i < tst->num_bins - 1; i++) {
+		tmp += HIST_BIN(h,i);
+		if (tmp > r)
+			break;
+	}
+	return i;
+}
+
+/**********************************************
+ * \brief Relative half-width of the 95% confidence interval of a quantile
+ *
+ * The interval is distribution-free: the true q-quantile lies between
+ * the order statistics n*q -/+ z*sqrt(n*q*(1-q)), taken at the outer
+ * edges of their bins. Needs h->nsamples. Returns -1.0 while there are
+ * too few samples to bound it, or when one of them is in the overflow bin.
+ **********************************************/
+double measurement_quantile_ci(test_p tst, histogram_p h, double q) {
+	double n, d, lo, hi, t, tlo, thi;
+	int b, blo, bhi;
+	n = (double)h->nsamples;
+	if (n == 0.0)
+		return -1.0;
+	d = CI_Z * sqrt(n * q * (1.0 - q));
+	lo = floor(n * q - d);
+	hi = ceil(n * q + d);
+	if ((lo < 0.0) || (hi > n - 1.0))
+		return -1.0;
+	b = measurement_rankbin(tst, h, (uint64_t)(n * q));
+	blo = measurement_rankbin(tst, h, (uint64_t)lo);
+	bhi = measurement_rankbin(tst, h, (uint64_t)hi);
+	/* the overflow bin has no upper edge, so it bounds nothing */
+	if ((b == tst->num_bins - 1) || (blo == tst->num_bins - 1) || (bhi == tst->num_bins - 1))
+		return -1.0;
+	t = bin2midtime(tst, b);
+	/* from the bottom of the low bin to the top of the high one: never below a bin */
+	tlo = bin2time(tst, blo);
+	thi = bin2time(tst, bhi + 1);
+	if (t <= 0.0)
+		return -1.0;
+	return (thi - tlo) / 2.0 / t;
+}
+
+/**********************************************
+ * \brief Decide collectively whether adaptive sampling may stop
+ *
+ * Aggregates the local measurement and checks the watched quantiles of
+ * every watched histogram that has samples. Returns 1 on every rank once
+ * all of their confidence intervals are within tst->ci_tolerance.
+ **********************************************/
+int measurement_converged(test_p tst, measurement_p m) {
+	measurement_p g;
+	histogram_p h;
+	int i, j, watched, converged = 0;
+	char reduce_root;
+	if (tst->ci_tolerance <= 0.0)
+		return 0;
+	g = measurement_real_create(tst, "converge", m->num_histograms);
+	/* only root reads the sum: reduce to root, whatever -R says */
+	reduce_root = tst->reduce_root;
+	tst->reduce_root = 1;
+	comm_aggregate(tst, g, m);
+	tst->reduce_root = reduce_root;
+	ROOTONLY {
+		watched = 0;
+		converged = 1;
+		for (i = 0; i < m->num_histograms; i++) {
+			if (!m->hist[i].converge)
+				continue;
+			h = &(g->hist[i]);
+			h->nsamples = measurement_samplecount(h, tst->num_bins);
+			/* nothing to watch (eg. no on-node pairs) */
+			if (h->nsamples == 0)
+				continue;
+			watched++;
+			for (j = 0; j < tst->num_quantiles; j++) {
+				double ci = measurement_quantile_ci(tst, h, tst->quantiles[j]);
+				if ((ci < 0.0) || (ci > tst->ci_tolerance))
+					converged = 0;
+			}
+		}
+		if (watched == 0)
+			converged = 0;
+		if (converged)
+			printf("Confidence: quantiles converged, stopping collection\n");
+	}
+	converged = comm_root_flag(converged);
+	g = measurement_destroy(g);
+	return converged;
+}
+
 /**********************************************
  * \brief Save the data to disk
  **********************************************/
@@ -281,6 +563,28 @@ void measurement_serialize(test_p tst, measurement_p m, int writingRankID) {
 	}
 }
 
+/**
+ \brief Whether a row of the HIST/PDF/CDF files is left out: no histogram
+ has samples in bin b, and only bins with samples are listed (not -d)
+*/
+static int measurement_skip_bin(test_p tst, measurement_p m, int b) {
+	int j;
+	if (tst->dense_output)
+		return 0;
+	for (j = 0; j < m->num_histograms; j++)
+		if (HIST_BIN(&m->hist[j],b) != 0)
+			return 0;
+	return 1;
+}
+
+/**
+ \brief Notes in a HIST/PDF/CDF file that empty bins are left out
+*/
+static void measurement_print_sparse(FILE *outfile, test_p tst) {
+	if (!tst->dense_output)
+		fprintf(outfile, "# Sparse:            bins without samples in any histogram are left out\n");
+}
+
 /**
  \brief Write the data into a cdf file
 */
@@ -300,6 +604,7 @@ void measurement_write_cdf(test_p tst, measurement_p m) {
 	Fcdf = fopen(fname, "w");
 	assert(Fcdf != NULL);
 	measurement_print_header(Fcdf, tst, m->label, NULL);
+	measurement_print_sparse(Fcdf, tst);
 
 	/* print histogram labels */
 	fprintf(Fcdf, "#%6s %18s ", "bin", " (us) to  (us)");
@@ -310,12 +615,14 @@ void measurement_write_cdf(test_p tst, measurement_p m) {
 
 	/* print the values */
 	for (i = 0; i < m->nbins; i++) {
+		if (measurement_skip_bin(tst, m, i))
+			continue;
 		binbot = bin2time(tst,i);
 		bintop = bin2time(tst,(i + 1));
 		binwidth = bintop - binbot;
 		fprintf(Fcdf, "%6d %11.4g %11.4g ", i, binbot * 1.0e+6, bintop * 1.0e+6);
 		for (j = 0; j < m->num_histograms; j++) {
-			cdf[j] += (double)(m->hist[j].dist[i]) / (double)NODIVIDEBYZERO(m->hist[j].nsamples);
+			cdf[j] += (double)HIST_BIN(&m->hist[j],i) / (double)NODIVIDEBYZERO(m->hist[j].nsamples);
 			fprintf(Fcdf, "%15.8e ", cdf[j]);
 		}
 		fprintf(Fcdf, "\n");
@@ -338,6 +645,7 @@ void measurement_write_pdf(test_p tst, measurement_p m) {
 	Fpdf = fopen(fname, "w");
 	assert(Fpdf != NULL);
 	measurement_print_header(Fpdf, tst, m->label, NULL);
+	measurement_print_sparse(Fpdf, tst);
 
 	/* print histogram labels */
 	fprintf(Fpdf, "#%6s %18s ", "bin", " (us) to  (us)");
@@ -348,12 +656,14 @@ void measurement_write_pdf(test_p tst, measurement_p m) {
 
 	/* print the values */
 	for (i = 0; i < m->nbins; i++) {
+		if (measurement_skip_bin(tst, m, i))
+			continue;
 		binbot = bin2time(tst,i);
 		bintop = bin2time(tst,(i + 1));
 		binwidth = bintop - binbot;
 		fprintf(Fpdf, "%6d %11.4g %11.4g ", i, binbot * 1.0e+6, bintop * 1.0e+6);
 		for (j = 0; j < m->num_histograms; j++) {
-			fprintf(Fpdf, "%15.8e ", (double)(m->hist[j].dist[i]) / binwidth
+			fprintf(Fpdf, "%15.8e ", (double)HIST_BIN(&m->hist[j],i) / binwidth
 					/ (double)NODIVIDEBYZERO(m->hist[j].nsamples) );
 		}
 		fprintf(Fpdf, "\n");
@@ -375,6 +685,7 @@ void measurement_write_hist(test_p tst, measurement_p m) {
 	Fhist = fopen(fname, "w");
 	assert(Fhist != NULL);
 	measurement_print_header(Fhist, tst, m->label, NULL);
+	measurement_print_sparse(Fhist, tst);
 
 	/* print histogram labels */
 	fprintf(Fhist, "#%6s %18s ", "bin", " (us) to  (us)");
@@ -385,12 +696,14 @@ void measurement_write_hist(test_p tst, measurement_p m) {
 
 	/* print the values */
 	for (i = 0; i < m->nbins; i++) {
+		if (measurement_skip_bin(tst, m, i))
+			continue;
 		binbot = bin2time(tst,i);
 		bintop = bin2time(tst,(i + 1));
 		binwidth = bintop - binbot;
 		fprintf(Fhist, "%6d %11.4g %11.4g ", i, binbot * 1.0e+6, bintop * 1.0e+6);
 		for (j = 0; j < m->num_histograms; j++) {
-			fprintf(Fhist, "%15"PRIu64" ", m->hist[j].dist[i] );
+			fprintf(Fhist, "%15"PRIu64" ", HIST_BIN(&m->hist[j],i) );
 		}
 		fprintf(Fhist, "\n");
 	}
@@ -427,6 +740,31 @@ void measurement_fmthist(test_p tst, histogram_p h, char *label) {
 	fprintf(Fstat, "Variance:     %15.2g seconds**2  %15.2g * minLatency**2\n", h->m20, h->m2s);			/* 2nd moment: 0,min-scaled */
 	fprintf(Fstat, "Skewness:     %15.2g seconds**3  %15.2g * minLatency**3\n", h->m30, h->m3s);			/* 3rd moment: 0,min-scaled */
 	fprintf(Fstat, "Kurtosis:     %15.2g seconds**4  %15.2g * minLatency**4\n", h->m40, h->m4s);			/* 4th moment: 0,min-scaled */
+	/* confidence in the quantiles adaptive sampling stopped on */
+	if ((tst->ci_tolerance > 0.0) && h->converge && (h->nsamples > 0)) {
+		int i;
+		double ci;
+		fprintf(Fstat, "\n");
+		for (i = 0; i < tst->num_quantiles; i++) {
+			ci = measurement_quantile_ci(tst, h, tst->quantiles[i]);
+			fprintf(Fstat, "Quantile %-8g %15.2g usec     95%% CI: ", tst->quantiles[i],
+				bin2midtime(tst, measurement_rankbin(tst, h, (uint64_t)((double)h->nsamples * tst->quantiles[i]))) * 1.0e+6);
+			if (ci < 0.0)
+				fprintf(Fstat, "too few samples\n");
+			else
+				fprintf(Fstat, "+/- %.3g%%\n", ci * 100.0);
+		}
+	}
+	/* transfer rates are monotone in the sample time, so the time quantiles map directly */
+	if ((h->messages > 0.0) && (h->nsamples > 0)) {
+		fprintf(Fstat, "\n");
+		fprintf(Fstat, "# %g messages, %g bytes per sample\n", h->messages, h->bytes);
+		fprintf(Fstat, "Bandwidth(Minimum time): %15.4g MB/s     Rate: %15.4g msgs/s\n", h->bytes / h->min0 / 1.0e+6, h->messages / h->min0);
+		fprintf(Fstat, "Bandwidth(Mode):         %15.4g MB/s     Rate: %15.4g msgs/s\n", h->bytes / h->mod0 / 1.0e+6, h->messages / h->mod0);
+		fprintf(Fstat, "Bandwidth(Median):       %15.4g MB/s     Rate: %15.4g msgs/s\n", h->bytes / h->med0 / 1.0e+6, h->messages / h->med0);
+		fprintf(Fstat, "Bandwidth(Mean time):    %15.4g MB/s     Rate: %15.4g msgs/s\n", h->bytes / h->m10 / 1.0e+6, h->messages / h->m10);
+		fprintf(Fstat, "Bandwidth(Maximum time): %15.4g MB/s     Rate: %15.4g msgs/s\n", h->bytes / h->max0 / 1.0e+6, h->messages / h->max0);
+	}
 	fclose(Fstat);
 }
 
@@ -451,12 +789,57 @@ void measurement_print_header(FILE *outfile, test_p tst, char *measurement_label
 		for (i=1; i<tst->argc; i++)
 			fprintf(outfile, "%s ", tst->argv[i]);
 		fprintf(outfile, "\n");
+	} else if (tst->test_type == COLL_TEST) {
+		fprintf(outfile, "# Message Size:      %d\n", tst->buf_len);
+		fprintf(outfile, "# Call Pattern:      %d cycle(s) of %d warmups and %d calls per collective\n",
+				tst->num_cycles, tst->num_warmup, tst->num_messages);
+	} else if (tst->test_type == C2C_TEST) {
+		fprintf(outfile, "# Ping-pong Pattern: %d cycle(s) of %d warmups and %d round trips per CPU pair\n",
+				tst->num_cycles, tst->num_warmup, tst->num_messages);
+	} else if (tst->test_type == FWQ_TEST) {
+		fprintf(outfile, "# Work Pattern:      %d cycle(s) of %d warmups and %d quanta of %g seconds per rank\n",
+				tst->num_cycles, tst->num_warmup, tst->num_messages, tst->fwq_quantum);
+	} else if (tst->test_type == MEM_TEST) {
+		fprintf(outfile, "# Working Set:       %d bytes\n", tst->buf_len);
+		if (tst->mem_node >= 0)
+			fprintf(outfile, "# NUMA Node:         %d\n", tst->mem_node);
+		fprintf(outfile, "# Chase Pattern:     %d cycle(s) of %d warmups and %d samples of %d dependent loads\n",
+				tst->num_cycles, tst->num_warmup, tst->num_messages, MEM_CHASE);
+	} else if (tst->test_type == TIMER_TEST) {
+		fprintf(outfile, "# Read Pattern:      %d cycle(s) of %d warmups and %d back-to-back read pairs per timer\n",
+				tst->num_cycles, tst->num_warmup, tst->num_messages);
 	} else {
 		fprintf(outfile, "# Message Size:      %d\n", tst->buf_len);
-		fprintf(outfile, "# Message Pattern:   %d cycle(s) through an all-pairs schedule\n", tst->num_cycles);
-		fprintf(outfile, "#                    of %d warmups and %d messages per pair\n", tst->num_warmup, tst->num_messages);
+		fprintf(outfile, "# Message Pattern:   %d cycle(s) through an all-pairs %s schedule\n", tst->num_cycles,
+				(tst->schedule == SCHED_ROUNDROBIN) ? "round-robin" : "XOR");
+		if (tst->test_type == WIN_TEST) {
+			fprintf(outfile, "#                    of %d warmups and %d windows per pair\n", tst->num_warmup, tst->num_messages);
+			fprintf(outfile, "# Window:            %d messages in flight\n", tst->window);
+		} else {
+			fprintf(outfile, "#                    of %d warmups and %d messages per pair\n", tst->num_warmup, tst->num_messages);
+		}
+	}
+	if ((tst->time_limit > 0.0) && (tst->test_type != IO_TEST)) {
+		fprintf(outfile, "# Time Limit:        %g seconds of collection (whole stages)\n", tst->time_limit);
+	}
+	if ((tst->topo_file != NULL) && (tst->test_type == NET_TEST)) {
+		fprintf(outfile, "# Topology:          %s\n", tst->topo_file);
+	}
+	if (tst->oneway && (tst->test_type == NET_TEST)) {
+		fprintf(outfile, "# One-way:           pair clock offsets from the fastest of %d round trips\n", NET_SYNC_ROUNDS);
+		fprintf(outfile, "#                    before and after each chunk, interpolated for drift\n");
+	}
+	if ((tst->ci_tolerance > 0.0) && (tst->test_type != IO_TEST)) {
+		fprintf(outfile, "# Adaptive Sampling: stop once the 95%% CI of quantiles");
+		for (i = 0; i < tst->num_quantiles; i++)
+			fprintf(outfile, " %g", tst->quantiles[i]);
+		fprintf(outfile, " is within %g%%\n", tst->ci_tolerance * 100.0);
 	}
-	if (tst->log_binning == 1) {
+	fprintf(outfile, "# Timer:             %s at %.10g Hz (%s)\n", HAVE_ORBTIMER_NATIVE, ORB_REFFREQ, ORB_freq_source);
+	if (tst->log_binning == BIN_LOGLINEAR) {
+		fprintf(outfile, "# Binning:           Log-linear, %d bins per octave of timer ticks, ending at %g seconds\n",
+				1 << tst->subbucket_bits, bin2time(tst, tst->num_bins));
+	} else if (tst->log_binning == BIN_LOG) {
 		fprintf(outfile, "# Binning:           Logarithmic, ending at %g seconds\n", tst->max_hist_time);
 	} else {
 		fprintf(outfile, "# Binning:           Linear, ending at %g seconds\n", tst->max_hist_time);
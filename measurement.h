@@ -24,11 +24,25 @@
 #define _MEASUREMENT_H
 
 #include "types.h"
+#include "config.h"
+#include "orbtimer.h"
+
+/* binning modes for tst->log_binning */
+enum {BIN_LINEAR=0, BIN_LOG=1, BIN_LOGLINEAR=2};
+
+/* measurement arena layouts for tst->hist_layout */
+enum {LAYOUT_HISTMAJOR=0, LAYOUT_BINMAJOR=1};
+
+/* tick deltas with the sign bit set are negative (invalid) samples */
+#define TICK_VALID(_C_) ( ((int64_t)(_C_)) >= 0 )
+#define FREQ_TOL 0.01	/* largest relative deviation of a rank's timer frequency from its node */
 
 /**************************************************************
  * FUNCTIONS
  **************************************************************/
 extern inline int time2bin(test_p tst, double t);
+extern inline int tick2bin(test_p tst, ORB_tick_t c);
+extern inline ORB_tick_t bin2tick(test_p tst, int b);
 extern inline double bin2time(test_p tst, int b);
 extern inline double bin2midtime(test_p tst, int b);
 
@@ -36,15 +50,19 @@ extern inline double bin2midtime(test_p tst, int b);
 measurement_p measurement_create(test_p tst, char *label);
 measurement_p measurement_real_create(test_p tst, char *label, int histograms);
 measurement_p measurement_destroy(measurement_p m);
+void measurement_merge(measurement_p dst, measurement_p src);
 
 /* calls the test specified in tst->test_type */
 void measurement_collect(test_p tst, measurement_p m);
+void measurement_calibrate(test_p tst);
 
 /* analysis functions */
 void measurement_moments(test_p tst, histogram_p h, double center, double *m1, double *m2, double *m3, double *m4);
-uint64_t measurement_samplecount(uint64_t *dist, int nbins);
+uint64_t measurement_samplecount(histogram_p h, int nbins);
 void measurement_histogram(test_p tst, histogram_p h, double scale);
 void measurement_analyze(test_p tst, measurement_p m, double scale);
+double measurement_quantile_ci(test_p tst, histogram_p h, double q);
+int measurement_converged(test_p tst, measurement_p m);
 
 /* output functions */
 void measurement_serialize(test_p tst, measurement_p m, int writingRankID);
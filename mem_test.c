@@ -0,0 +1,238 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+/**
+ * \brief Memory latency test: every rank chases pointers through a
+ * randomly linked working set of each -B size, timing dependent loads.
+ *
+ * Pros: 
+ * - Measures the node's load-to-use latency at every level of the
+ *   memory hierarchy, separately from the on-node MPI numbers
+ * - Aggregates over all ranks, so slow DIMMs or misconfigured nodes
+ *   show up in the fleet distribution
+ *
+ * Cons:
+ * - Each sample is the average of MEM_CHASE dependent loads, as single
+ *   loads are shorter than the timer overhead
+ * - Working sets are -B sizes, so at most 2 GB
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "config.h"
+#include "orbtimer.h"
+#include "comm.h"
+#include "tests.h"
+#include "measurement.h"
+
+/* number of memory latency histograms */
+#define MEM_LEN 3
+
+/* histograms for memory latency measurements */
+enum mem_vars {
+	/* timer overhead */
+	memTimer,
+	/* latency per load of each sample, and the fastest sample of each rank and cycle */
+	load, loadMinimum
+};
+
+char *mem_labels[] = {
+	/* timer overhead */
+	"timer",
+	"load", "loadMinimum"
+};
+
+/* one pointer per cache line of the working set */
+#define MEM_LINE CACHELINE
+
+/* dependent loads per sample (MEM_CHASE, tests.h) are unrolled in steps of 8 */
+#define MEM_UNROLL 8
+#define MEM_HOP(_P_) _P_ = *(void * volatile *)(_P_)
+
+/* memory policy for mbind(2), from <numaif.h> */
+#define MEM_MPOL_BIND 2
+/**
+ \brief Create the measurement struct for the test
+ \param tst Will tell the test how many times to run
+ \param label A label for the measurement struct
+*/
+measurement_p mem_measurement_create(test_p tst, char *label) {
+	int i;
+	measurement_p m = measurement_real_create(tst, label, MEM_LEN);
+	for (i = 0; i < MEM_LEN; i++)
+		strncpy(m->hist[i].label,mem_labels[i],LABEL_LEN);
+	/* adaptive sampling watches the loads */
+	m->hist[load].converge = 1;
+	return m;
+}
+
+/**
+ \brief Next number of a per-rank xorshift generator
+*/
+static uint64_t mem_random(uint64_t *state) {
+	uint64_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return (*state = x);
+}
+
+/**
+ \brief Binds a working set to tst->mem_node before it is first touched
+ \return 0, or 1 if the kernel refused
+*/
+static int mem_bind(test_p tst, void *ws, size_t len) {
+#ifdef SYS_mbind
+	unsigned long mask[MEM_MAX_NODES / (8 * sizeof(unsigned long))];
+	int bits = 8 * sizeof(unsigned long);
+	memset(mask, 0, sizeof(mask));
+	mask[tst->mem_node / bits] = 1UL << (tst->mem_node % bits);
+	return (syscall(SYS_mbind, ws, len, MEM_MPOL_BIND, mask, (unsigned long)MEM_MAX_NODES, 0) != 0);
+#else
+	return 1;
+#endif
+}
+
+/**
+ \brief Links the cache lines of a working set into one cycle in random order
+ \return The first line of the cycle
+
+ Sattolo's shuffle gives a single cycle through every line, so the
+ chase visits the whole working set before it repeats.
+*/
+static void *mem_link(char *ws, size_t nlines) {
+	uint32_t *perm, tmp;
+	uint64_t state = 88172645463325252ULL + (uint64_t)my_rank;
+	size_t i, j;
+	perm = (uint32_t *)malloc(nlines * sizeof(uint32_t));
+	assert(perm != NULL);
+	for (i = 0; i < nlines; i++)
+		perm[i] = (uint32_t)i;
+	for (i = nlines - 1; i > 0; i--) {
+		j = (size_t)(mem_random(&state) % i);
+		tmp = perm[i];
+		perm[i] = perm[j];
+		perm[j] = tmp;
+	}
+	for (i = 0; i < nlines; i++)
+		*(void **)(ws + i * MEM_LINE) = (void *)(ws + (size_t)perm[i] * MEM_LINE);
+	free(perm);
+	return (void *)ws;
+}
+
+/**
+ \brief Chases pointers through a working set of tst->buf_len bytes
+ \param tst Gives the working set, cycles, warmups and samples per cycle
+ \param m Collects measurement data from the test
+*/
+void mem_test(test_p tst, measurement_p m) {
+	ORB_tick_t *c, *t, cmin;
+	volatile void *sink;
+	size_t len, nlines, i;
+	void *p;
+	char *ws;
+	int j, k, icycle, stop = 0;
+	ORB_t t1, t2, t3;
+
+	/* at least two lines, so there is a cycle to chase */
+	nlines = (size_t)m->buflen / MEM_LINE;
+	if (nlines < 2)
+		nlines = 2;
+	len = nlines * MEM_LINE;
+	ws = (char *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert(ws != MAP_FAILED);
+	if ((tst->mem_node >= 0) && mem_bind(tst, ws, len))
+		fprintf(stderr, "Rank %d: can not bind the working set to NUMA node %d, using local memory\n",
+			my_rank, tst->mem_node);
+	p = mem_link(ws, nlines);
+
+	c = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for sample timings */
+	assert(c != NULL);
+	t = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for timer overhead timings */
+	assert(t != NULL);
+
+	/* calibrate timer */
+	measurement_calibrate(tst);
+	/* bring the working set in as far as it fits */
+	for (i = 0; i < nlines; i++)
+		MEM_HOP(p);
+	comm_barrier();
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
+		/* warm-up */
+		for (j = 0; j < tst->num_warmup; j++)
+			for (k = 0; k < MEM_CHASE; k++)
+				MEM_HOP(p);
+		/****************************************************************/
+		/* BEGIN PERFORMANCE KERNEL -- gather the samples of this cycle */
+		/****************************************************************/
+		for (j = 0; j < tst->num_messages; j++) {
+			/* for timer overhead estimate */
+			ORB_read(t1);
+			ORB_read(t2);
+			for (k = 0; k < MEM_CHASE; k += MEM_UNROLL) {
+				MEM_HOP(p); MEM_HOP(p); MEM_HOP(p); MEM_HOP(p);
+				MEM_HOP(p); MEM_HOP(p); MEM_HOP(p); MEM_HOP(p);
+			}
+			ORB_read(t3);
+			t[j] = ORB_cycles(t2, t1);
+			c[j] = ORB_cycles(t3, t2);
+		}
+		/****************************************************************/
+		/* END PERFORMANCE KERNEL -- samples of this cycle gathered     */
+		/****************************************************************/
+
+		/* bin the latency per load */
+		cmin = ~((ORB_tick_t)0);
+		for (j = 0; j < tst->num_messages; j++) {
+			if (TICK_VALID(t[j]))
+				MEASUREMENT_BIN(m, memTimer, tick2bin(tst,t[j]))++;
+			if (!TICK_VALID(c[j]))
+				continue;
+			MEASUREMENT_BIN(m, load, tick2bin(tst,c[j] / MEM_CHASE))++;
+			if (c[j] < cmin)
+				cmin = c[j];
+		}
+		if (TICK_VALID(cmin))
+			MEASUREMENT_BIN(m, loadMinimum, tick2bin(tst,cmin / MEM_CHASE))++;
+
+		/* out of time? all ranks stop after the same cycle */
+		stop = comm_time_expired(tst);
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
+	}
+	/* keep the chase live */
+	sink = p;
+	(void)sink;
+	free(t);
+	free(c);
+	munmap(ws, len);
+	return;
+}
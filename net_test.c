@@ -31,6 +31,8 @@
  *
  * Cons:
  * - Requires additional storage
+ * - One-way latencies (-s) rest on clock offsets estimated from the
+ *   fastest round trips, assumed symmetric
  */
 
 #include <unistd.h>
@@ -39,12 +41,18 @@
 #include <assert.h>
 #include <stdio.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "config.h"
 #include "orbtimer.h"
 #include "comm.h"
 #include "tests.h"
 #include "measurement.h"
+#include "topology.h"
+#include "placement.h"
+#include "pairs.h"
+#include "trace.h"
+#include "outlier.h"
 
 #ifdef SHMEM
 	#include <mpp/shmem.h>
@@ -67,6 +75,43 @@ enum net_vars {
 	offNodeOnesidedMinimum, offNodePairwiseMinimum
 };
 
+/* offsets within a family of one-sided, pairwise and minimum histograms */
+#define NET_PW (onNodePairwise - onNodeOnesided)
+#define NET_MIN (onNodeOnesidedMinimum - onNodeOnesided)
+#define NET_FAMILY 4
+
+/* timings cross the network as saturated 32-bit tick deltas */
+#define TICK32_INVALID UINT32_MAX
+#define TICK32_MAX (UINT32_MAX - 1)
+
+/* with placements (-a), one more family per on-node class (PLACE_L3,
+ * PLACE_SOCKET, PLACE_CROSS) follows the topology families */
+#define NET_PLACE_BASE(_T_) (NET_LEN + (((_T_)->topo_coord != NULL) ? TOPO_CLASSES * NET_FAMILY : 0))
+
+/* with threads per rank (-p), the on-node and off-node families are
+ * repeated for each thread count, after the placement families */
+#define NET_THREAD_LEN (2 * NET_FAMILY)
+#define NET_THREAD_BASE(_T_) (NET_PLACE_BASE(_T_) + (((_T_)->place_coord != NULL) ? PLACE_CLASSES * NET_FAMILY : 0))
+
+/* with one-way latencies (-s), an on-node and an off-node pair of
+ * one-way and one-way minimum histograms come last */
+#define NET_ONEWAY_LEN 4
+#define NET_ONEWAY_BASE(_T_) (NET_THREAD_BASE(_T_) + (_T_)->num_thread_counts * NET_THREAD_LEN)
+
+/* one thread of the threaded net test, running a pair on its own tag */
+typedef struct net_thread {
+	test_p tst;
+	measurement_p m;	/* thread-local histograms, merged when the test ends */
+	buffer_p sbuf, rbuf;	/* thread-local exchange buffers */
+	ORB_tick_t *cos, *cpw;	/* a chunk of one-sided and pairwise timings */
+	uint32_t *xos, *xpw;	/* the chunk as exchanged with the partner thread */
+	int chunk;
+	int tag;
+	int partner_rank;
+	int nfam, fam[2];	/* histogram families of the current pair */
+	pthread_t id;
+} net_thread_t, *net_thread_p;
+
 char *net_labels[] = {
 	/* timer overhead */
 	"timer",
@@ -78,19 +123,208 @@ char *net_labels[] = {
 	"offNodeOnesidedMinimum", "offNodePairwiseMinimum"
 };
 
+/* with a topology, one more family per off-node distance class
+ * (TOPO_SWITCH, TOPO_GROUP, TOPO_SYSTEM) follows the NET_LEN histograms */
+char *net_topo_labels[] = {
+	"sameSwitchOnesided", "sameSwitchPairwise",
+	"sameSwitchOnesidedMinimum", "sameSwitchPairwiseMinimum",
+	"sameGroupOnesided", "sameGroupPairwise",
+	"sameGroupOnesidedMinimum", "sameGroupPairwiseMinimum",
+	"otherGroupOnesided", "otherGroupPairwise",
+	"otherGroupOnesidedMinimum", "otherGroupPairwiseMinimum"
+};
+
+char *net_oneway_labels[] = {
+	"onNodeOneway", "onNodeOnewayMinimum",
+	"offNodeOneway", "offNodeOnewayMinimum"
+};
+
+char *net_place_labels[] = {
+	"sameL3Onesided", "sameL3Pairwise",
+	"sameL3OnesidedMinimum", "sameL3PairwiseMinimum",
+	"sameSocketOnesided", "sameSocketPairwise",
+	"sameSocketOnesidedMinimum", "sameSocketPairwiseMinimum",
+	"crossSocketOnesided", "crossSocketPairwise",
+	"crossSocketOnesidedMinimum", "crossSocketPairwiseMinimum"
+};
+
 /**
  \brief Create the measurement struct for the test
  \param tst Will tell the test how many times to run
  \param label A label for the measurement struct
 */
 measurement_p net_measurement_create(test_p tst, char *label) {
-	int i;
-	measurement_p m = measurement_real_create(tst, label, NET_LEN);
+	int i, k, n = NET_LEN;
+	if (tst->topo_coord != NULL)
+		n += TOPO_CLASSES * NET_FAMILY;
+	if (tst->place_coord != NULL)
+		n += PLACE_CLASSES * NET_FAMILY;
+	n += tst->num_thread_counts * NET_THREAD_LEN;
+	if (tst->oneway)
+		n += NET_ONEWAY_LEN;
+	measurement_p m = measurement_real_create(tst, label, n);
 	for (i = 0; i < NET_LEN; i++)
 		strncpy(m->hist[i].label,net_labels[i],LABEL_LEN);
+	for (i = NET_LEN; i < NET_PLACE_BASE(tst); i++)
+		strncpy(m->hist[i].label,net_topo_labels[i - NET_LEN],LABEL_LEN);
+	for (i = NET_PLACE_BASE(tst); i < NET_THREAD_BASE(tst); i++)
+		strncpy(m->hist[i].label,net_place_labels[i - NET_PLACE_BASE(tst)],LABEL_LEN);
+	/* the on-node and off-node families again for each thread count */
+	for (k = 0; k < tst->num_thread_counts; k++)
+		for (i = 0; i < NET_THREAD_LEN; i++)
+			snprintf(m->hist[NET_THREAD_BASE(tst) + k * NET_THREAD_LEN + i].label, LABEL_LEN,
+				 "%sT%d", net_labels[onNodeOnesided + i], tst->thread_counts[k]);
+	if (tst->oneway)
+		for (i = 0; i < NET_ONEWAY_LEN; i++)
+			strncpy(m->hist[NET_ONEWAY_BASE(tst) + i].label,net_oneway_labels[i],LABEL_LEN);
+	/* adaptive sampling watches the pairwise histograms */
+	m->hist[onNodePairwise].converge = m->hist[offNodePairwise].converge = 1;
 	return m;
 }
 
+#ifndef SHMEM
+/**
+ \brief Sets up one thread of the threaded net test (MPI)
+ \param m The rank's measurement, whose histograms the thread mirrors
+ \param tag Message tag of the thread, the same on both partners
+ \param chunk Timings per chunk
+*/
+static void net_thread_init(test_p tst, measurement_p m, net_thread_p th, int tag, int chunk) {
+	th->tst = tst;
+	th->m = measurement_real_create(tst, m->label, m->num_histograms);
+	th->sbuf = comm_newbuffer(m->buflen > 0 ? m->buflen : 1);
+	th->rbuf = comm_newbuffer(m->buflen > 0 ? m->buflen : 1);
+	th->cos = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));
+	assert(th->cos != NULL);
+	th->cpw = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));
+	assert(th->cpw != NULL);
+	th->xos = (uint32_t *)malloc(2 * chunk * sizeof(uint32_t));
+	assert(th->xos != NULL);
+	th->xpw = th->xos + chunk;
+	th->chunk = chunk;
+	th->tag = tag;
+	th->partner_rank = -1;
+	th->nfam = 0;
+}
+
+/**
+ \brief Frees one thread of the threaded net test
+ \sa net_thread_init
+*/
+static void net_thread_free(net_thread_p th) {
+	th->m = measurement_destroy(th->m);
+	comm_freebuffer(th->sbuf);
+	comm_freebuffer(th->rbuf);
+	free(th->cos);
+	free(th->cpw);
+	free(th->xos);
+}
+
+/**
+ \brief Runs one visit of a pair in one thread (MPI_THREAD_MULTIPLE)
+ \param arg The thread (net_thread_p); partner_rank and fam are set for the pair
+
+ Each thread exchanges with the thread of the same tag on the partner,
+ while the other threads of both ranks do the same, and bins into its
+ own histograms. The timer overhead is not measured again.
+*/
+static void *net_MPI_thread(void *arg) {
+	net_thread_p th = (net_thread_p)arg;
+	test_p tst = th->tst;
+	ORB_tick_t cosmin, cpwmin;
+	int i, c0, n, ierr = 0;
+	ORB_t t2, t3;
+	MPI_Status mpistatus;
+
+	/* warm-up / pre-synchronize this pair of threads */
+	for (i = 0; i < tst->num_warmup; i++)
+		ierr += MPI_Sendrecv(th->sbuf->data, th->m->buflen, MPI_BYTE, th->partner_rank, th->tag,
+				     th->rbuf->data, th->m->buflen, MPI_BYTE, th->partner_rank, th->tag,
+				     MPI_COMM_WORLD, &mpistatus);
+	cosmin = cpwmin = ~((ORB_tick_t)0);
+	for (c0 = 0; c0 < tst->num_messages; c0 += n) {
+		n = tst->num_messages - c0;
+		if (n > th->chunk)
+			n = th->chunk;
+		/*************************************************************/
+		/* BEGIN PERFORMANCE KERNEL -- gather a chunk of samples     */
+		/*************************************************************/
+		for (i = 0; i < n; i++) {
+			ORB_read(t2);
+			ierr += MPI_Sendrecv(th->sbuf->data, th->m->buflen, MPI_BYTE, th->partner_rank, th->tag,
+					     th->rbuf->data, th->m->buflen, MPI_BYTE, th->partner_rank, th->tag,
+					     MPI_COMM_WORLD, &mpistatus);
+			ORB_read(t3);
+			th->cos[i] = ORB_cycles(t3, t2);
+		}
+		/*************************************************************/
+		/* END PERFORMANCE KERNEL -- chunk of samples gathered       */
+		/*************************************************************/
+		net_pack(th->cos, th->xos, n);
+		ierr += MPI_Sendrecv(th->xos, n, MPI_UNSIGNED, th->partner_rank, th->tag,
+				     th->xpw, n, MPI_UNSIGNED, th->partner_rank, th->tag,
+				     MPI_COMM_WORLD, &mpistatus);
+		net_unpack(th->xpw, th->cpw, n, th->partner_rank);
+		net_pairwise(tst, th->cos, th->cpw, n);
+		net_measurement_bin(tst, th->m, NULL, th->cos, th->cpw, n, th->nfam, th->fam, &cosmin, &cpwmin);
+	}
+	net_measurement_binmin(tst, th->m, cosmin, cpwmin, th->nfam, th->fam);
+	assert(ierr == 0);
+	return NULL;
+}
+
+/**
+ \brief Estimates the partner's clock offset, NTP style (MPI)
+ \param t0 This rank's time origin; both clocks are read as ticks since their origin
+ \param s Filled with the time of the estimate on this rank's clock (s[0]) and
+ the partner's clock minus this rank's (s[1]), in ticks
+
+ The lower rank of the pair sends NET_SYNC_ROUNDS pings, the partner
+ answers each with its clock. The round trip with the least latency
+ gives the offset, assuming it took as long in both directions, and the
+ lower rank sends the result back.
+*/
+static void net_MPI_sync(int partner_rank, ORB_t t0, double *s) {
+	ORB_tick_t a, b, c, best = ~((ORB_tick_t)0);
+	double r[2] = {0.0, 0.0};
+	int k, ierr = 0;
+	ORB_t t;
+	MPI_Status mpistatus;
+
+	if (my_rank < partner_rank) {
+		for (k = 0; k < NET_SYNC_ROUNDS; k++) {
+			ORB_read(t);
+			a = ORB_cycles_u(t, t0);
+			ierr += MPI_Send(&a, 1, MPI_UNSIGNED_LONG_LONG, partner_rank, 0, MPI_COMM_WORLD);
+			ierr += MPI_Recv(&b, 1, MPI_UNSIGNED_LONG_LONG, partner_rank, 0, MPI_COMM_WORLD, &mpistatus);
+			ORB_read(t);
+			c = ORB_cycles_u(t, t0);
+			if (c - a < best) {
+				best = c - a;
+				r[0] = 0.5 * ((double)a + (double)c);
+				r[1] = (double)b - r[0];
+			}
+		}
+		ierr += MPI_Send(r, 2, MPI_DOUBLE, partner_rank, 0, MPI_COMM_WORLD);
+		s[0] = r[0];
+		s[1] = r[1];
+	} else {
+		for (k = 0; k < NET_SYNC_ROUNDS; k++) {
+			ierr += MPI_Recv(&a, 1, MPI_UNSIGNED_LONG_LONG, partner_rank, 0, MPI_COMM_WORLD, &mpistatus);
+			ORB_read(t);
+			b = ORB_cycles_u(t, t0);
+			ierr += MPI_Send(&b, 1, MPI_UNSIGNED_LONG_LONG, partner_rank, 0, MPI_COMM_WORLD);
+		}
+		ierr += MPI_Recv(r, 2, MPI_DOUBLE, partner_rank, 0, MPI_COMM_WORLD, &mpistatus);
+		/* the same instant and offset, seen from this side */
+		s[0] = r[0] + r[1];
+		s[1] = -r[1];
+	}
+	assert(ierr == 0);
+}
+#endif
+
+
 /**
  \brief Exchanges messages between all the nodes on the system to test the network connections between them
  \param tst Tells how many cycles to run the test
@@ -101,24 +335,46 @@ void net_SHMEM_test(test_p tst, measurement_p m) {
 	static int sync;
 	sync = my_rank;
 	buffer_t *sbuf, *rbuf;
-	double *cos, *cpw, *t;
-	int i, icycle, istage, partner_rank;
-	ORB_t t1, t2, t3;
+	ORB_tick_t *cos, *cpw, *t, *ts = NULL, cosmin, cpwmin;
+	uint32_t *xos, *xpw;
+	trace_p tr = NULL;
+	int i, c0, n, chunk, dist, nfam, fam[2], icycle, istage, partner_rank, stop = 0;
+	ORB_t t0, t1, t2, t3;
 //Make
-	sbuf = comm_newbuffer(m->buflen);	/* exchange buffers */
-	rbuf = comm_newbuffer(m->buflen);
-	cos = (double *)shmalloc(tst->num_messages * sizeof(double));	/* array for onesided kernel timings */
+	sbuf = tst->buf[0];	/* exchange buffers */
+	rbuf = tst->buf[1];
+	/* timings are collected, exchanged and binned a chunk at a time */
+	chunk = (tst->num_messages < tst->chunk) ? tst->num_messages : tst->chunk;
+	cos = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for onesided kernel timings */
 	assert(cos != NULL);
-	cpw = (double *)malloc(tst->num_messages * sizeof(double));	/* array for pairwise kernel timings */
+	xos = (uint32_t *)shmalloc(chunk * sizeof(uint32_t));	/* onesided timings as sent to partner */
+	assert(xos != NULL);
+	xpw = (uint32_t *)malloc(chunk * sizeof(uint32_t));	/* partner's onesided timings as received */
+	assert(xpw != NULL);
+	cpw = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for pairwise kernel timings */
 	assert(cpw != NULL);
-	t = (double *)malloc(tst->num_messages * sizeof(double));	/* array for timer overhead timings */
+	t = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for timer overhead timings */
 	assert(t != NULL);
+	if (tst->pair_matrix || (tst->suspect_k > 0.0))
+		m->pairs = pairs_create(tst);	/* per-partner summaries */
+	if (tst->outlier_threshold != 0.0)
+		m->outliers = outlier_create(tst);	/* ring of slow samples */
+	if (tst->trace || (m->outliers != NULL)) {
+		ts = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for sample start times */
+		assert(ts != NULL);
+	}
 
 // Exec
 	/* calibrate timer */
-	ORB_calibrate();
+	measurement_calibrate(tst);
+	/* after calibrating: the trace header records the timer frequency */
+	if (tst->trace)
+		tr = trace_open(tst, m);
 	/* pre-synchronize all tasks */
 	shmem_barrier_all();
+	comm_time_start(tst);
+	/* trace times count from here */
+	ORB_read(t0);
 	/*****************************************************************************
 	 * A full set of samples for this task consists of message exchanges with each
 	 * possible partner. The innermost loop below exchanges some number of messages
@@ -126,15 +382,20 @@ void net_SHMEM_test(test_p tst, measurement_p m) {
 	 * possible partners. While the outmost allows us to aggregate multiple sets
 	 * of samples to increase the total number of samples.
 	 *****************************************************************************/
-	for (icycle = 0; icycle < tst->num_cycles; icycle++) {
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
 		/* step through the stage schedule */
 		for (istage = 0; istage < tst->num_stages; istage++) {
+			/* out of time? all ranks stop at the same stage boundary */
+			if ((stop = comm_time_expired(tst)))
+				break;
 			shmem_barrier_all();
 			/* who's my buddy for this stage? */
-			partner_rank = my_rank ^ istage;
+			partner_rank = comm_partner(tst, istage);
 			/* valid pairing */
-			if ((partner_rank < num_ranks) && (partner_rank != my_rank)) {
+			if (partner_rank >= 0) {
 				/* valid pair, proceed with test */
+				dist = topology_distance(tst, my_rank, partner_rank);
+				nfam = net_families(tst, dist, placement_distance(tst, my_rank, partner_rank), fam);
 				
 				/***************************************/
 				/* warm-up / pre-synchronize this pair */
@@ -146,58 +407,91 @@ void net_SHMEM_test(test_p tst, measurement_p m) {
 					ORB_read(t3);
 				}
 				
-				/* synchronize partners */
-				shmem_int_p(&sync, my_rank, partner_rank);
-				shmem_int_wait_until(&sync, SHMEM_CMP_EQ, partner_rank);
-				sync = my_rank;
-				
-				/************************************************************/
-				/* BEGIN PERFORMANCE KERNEL -- gather samples for this pair */
-				/************************************************************/
-				for (i = 0; i < tst->num_messages; i++) {
-					/* for timer overhead estimate */
-					ORB_read(t1);
-					ORB_read(t2);
-					/***************************************/
-					/* begin timed communication primitive */
-					/***************************************/
-					shmem_getmem(rbuf->data, sbuf->data, m->buflen, partner_rank);
-					/*************************************/
-					/* end timed communication primitive */
-					/*************************************/
-					ORB_read(t3);
-					/* save the timings */
-					t[i] = ORB_seconds(t2, t1);
-					cos[i] = ORB_seconds(t3, t2);
+				/* the pair's minimums span all of its chunks */
+				cosmin = cpwmin = ~((ORB_tick_t)0);
+				for (c0 = 0; c0 < tst->num_messages; c0 += n) {
+					n = tst->num_messages - c0;
+					if (n > chunk)
+						n = chunk;
+					/* synchronize partners */
+					shmem_int_p(&sync, my_rank, partner_rank);
+					shmem_int_wait_until(&sync, SHMEM_CMP_EQ, partner_rank);
+					sync = my_rank;
+
+					/*************************************************************/
+					/* BEGIN PERFORMANCE KERNEL -- gather a chunk of samples     */
+					/*************************************************************/
+					for (i = 0; i < n; i++) {
+						/* for timer overhead estimate */
+						ORB_read(t1);
+						ORB_read(t2);
+						/***************************************/
+						/* begin timed communication primitive */
+						/***************************************/
+						shmem_getmem(rbuf->data, sbuf->data, m->buflen, partner_rank);
+						/*************************************/
+						/* end timed communication primitive */
+						/*************************************/
+						ORB_read(t3);
+						/* save the timings in ticks, convert when binning */
+						t[i] = ORB_cycles(t2, t1);
+						cos[i] = ORB_cycles(t3, t2);
+						if (ts != NULL)
+							ts[i] = ORB_cycles_u(t2, t0);
+					}
+					/*************************************************************/
+					/* END PERFORMANCE KERNEL -- chunk of samples gathered       */
+					/*************************************************************/
+
+					/* narrow the chunk for the partner to read */
+					net_pack(cos, xos, n);
+
+					/* ensure partner has completed sample collection */
+					shmem_int_p(&sync, my_rank, partner_rank);
+					shmem_int_wait_until(&sync, SHMEM_CMP_EQ, partner_rank);
+					sync = my_rank;
+
+					/* get partner's chunk of local timings */
+					shmem_get32(xpw, xos, n, partner_rank);
+					net_unpack(xpw, cpw, n, partner_rank);
+
+					/* pairwise as average, comparable to one-sided */
+					net_pairwise(tst, cos, cpw, n);
+					/* bin the t, cos, and cpw results for this chunk */
+					net_measurement_bin(tst, m, t, cos, cpw, n, nfam, fam, &cosmin, &cpwmin);
+					/* and fold them into this partner's summary */
+					if (m->pairs != NULL)
+						pairs_add(tst, m->pairs, partner_rank, cpw, n);
+					/* and stream the raw samples */
+					if (tr != NULL)
+						trace_stage(tr, ts, cos, cpw, n, partner_rank, icycle);
+					/* and log the slow ones */
+					if (m->outliers != NULL)
+						outlier_ticks(tst, m->outliers, ts, cos, n, partner_rank, icycle, istage);
 				}
-				/************************************************************/
-				/* END PERFORMANCE KERNEL -- samples gathered for this pair */
-				/************************************************************/
-				
-				/* ensure partner has completed sample collection */
+				/* partner is done reading this rank's timings */
 				shmem_int_p(&sync, my_rank, partner_rank);
 				shmem_int_wait_until(&sync, SHMEM_CMP_EQ, partner_rank);
 				sync = my_rank;
-				
-				/* get partner's array of local timings */
-				shmem_double_get(cpw, cos, tst->num_messages, partner_rank);
-				
-				/* pairwise as average, comparable to one-sided */
-				for (i = 0; i < tst->num_messages; i++) {
-					cpw[i] = (cpw[i] + cos[i]) / 2.0;
-				}
-				/* bin the t, cos, and cpw results for this cycle of this pair in p */
-				net_measurement_bin(tst, m, t, cos, cpw, (node_id[my_rank] == node_id[partner_rank]));
+				/* bin the minimums for this cycle of this pair */
+				net_measurement_binmin(tst, m, cosmin, cpwmin, nfam, fam);
 			} /* if valid pairing */
 		} /* for istage */
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
 	} /* for icycle */
 
 // Kill
+	if (tr != NULL)
+		tr = trace_close(tr);
+	if (ts != NULL)
+		free(ts);
 	free(t);
 	free(cpw);
-	shfree(cos);
-	comm_freebuffer(rbuf);
-	comm_freebuffer(sbuf);
+	free(xpw);
+	shfree(xos);
+	free(cos);
 #endif
 	return;
 }
@@ -210,22 +504,68 @@ void net_SHMEM_test(test_p tst, measurement_p m) {
 void net_MPI_test(test_p tst, measurement_p m) {
 #ifndef SHMEM
 	buffer_t *sbuf, *rbuf;
-	double *cos, *cpw, *t;
-	int i, icycle, istage, ierr, partner_rank;
-	ORB_t t1, t2, t3;
+	ORB_tick_t *cos, *cpw, *t, *ts = NULL, cosmin, cpwmin;
+	ORB_tick_t *te = NULL, *tp = NULL, *cow = NULL, owmin;
+	uint64_t owskip = 0, owskipped = 0;
+	uint32_t *xos, *xpw;
+	trace_p tr = NULL;
+	double s0[2], s1[2];
+	int i, j, k, c0, n, chunk, dist, nfam, fam[2], icycle, istage, ierr, partner_rank, stop = 0;
+	int max_threads = 0;
+	net_thread_p th = NULL;
+	ORB_t t0, t1, t2, t3;
 	MPI_Status mpistatus;
-	sbuf = comm_newbuffer(m->buflen);	/* exchange buffers */
-	rbuf = comm_newbuffer(m->buflen);
-	cos = (double *)malloc(tst->num_messages * sizeof(double));	/* array for onesided kernel timings */
+	sbuf = tst->buf[0];	/* exchange buffers */
+	rbuf = tst->buf[1];
+	/* timings are collected, exchanged and binned a chunk at a time */
+	chunk = (tst->num_messages < tst->chunk) ? tst->num_messages : tst->chunk;
+	cos = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for onesided kernel timings */
 	assert(cos != NULL);
-	cpw = (double *)malloc(tst->num_messages * sizeof(double));	/* array for pairwise kernel timings */
+	xos = (uint32_t *)malloc(2 * chunk * sizeof(uint32_t));	/* onesided timings as exchanged with partner */
+	assert(xos != NULL);
+	xpw = xos + chunk;
+	cpw = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for pairwise kernel timings */
 	assert(cpw != NULL);
-	t = (double *)malloc(tst->num_messages * sizeof(double));	/* array for timer overhead timings */
+	t = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for timer overhead timings */
 	assert(t != NULL);
+	if (tst->pair_matrix || (tst->suspect_k > 0.0))
+		m->pairs = pairs_create(tst);	/* per-partner summaries */
+	if (tst->outlier_threshold != 0.0)
+		m->outliers = outlier_create(tst);	/* ring of slow samples */
+	if (tst->trace || (m->outliers != NULL) || tst->oneway) {
+		ts = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for sample start times */
+		assert(ts != NULL);
+	}
+	if (tst->oneway) {
+		te = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for sample end times */
+		assert(te != NULL);
+		tp = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* partner's sample start times */
+		assert(tp != NULL);
+		cow = (ORB_tick_t *)malloc(chunk * sizeof(ORB_tick_t));	/* array for one-way timings */
+		assert(cow != NULL);
+		if (tst->pair_matrix)
+			m->oneway = pairs_create(tst);	/* per-partner one-way summaries */
+	}
+	/* threads for the thread counts, reused by every pair */
+	for (k = 0; k < tst->num_thread_counts; k++)
+		if (tst->thread_counts[k] > max_threads)
+			max_threads = tst->thread_counts[k];
+	if (max_threads > 0) {
+		th = (net_thread_p)malloc(max_threads * sizeof(net_thread_t));
+		assert(th != NULL);
+		for (j = 0; j < max_threads; j++)
+			net_thread_init(tst, m, &th[j], j + 1, chunk);
+	}
 	/* calibrate timer */
-	ORB_calibrate();
+	measurement_calibrate(tst);
+	/* after calibrating: the trace header records the timer frequency */
+	if (tst->trace)
+		tr = trace_open(tst, m);
 	/* pre-synchronize all tasks */
 	ierr = MPI_Barrier(MPI_COMM_WORLD);
+	comm_time_start(tst);
+	/* trace times count from here */
+	ORB_read(t0);
 	/*****************************************************************************
 	 * A full set of samples for this task consists of message exchanges with each
 	 * possible partner. The innermost loop below exchanges some number of messages
@@ -233,14 +573,19 @@ void net_MPI_test(test_p tst, measurement_p m) {
 	 * possible partners. While the outmost allows us to aggregate multiple sets
 	 * of samples to increase the total number of samples.
 	 *****************************************************************************/
-	for (icycle = 0; icycle < tst->num_cycles; icycle++) {
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
 		/* step through the stage schedule */
 		for (istage = 0; istage < tst->num_stages; istage++) {
+			/* out of time? all ranks stop at the same stage boundary */
+			if ((stop = comm_time_expired(tst)))
+				break;
 			/* who's my buddy for this stage? */
-			partner_rank = my_rank ^ istage;
+			partner_rank = comm_partner(tst, istage);
 			/* valid pairing */
-			if ((partner_rank < num_ranks) && (partner_rank != my_rank)) {
+			if (partner_rank >= 0) {
 				/* valid pair, proceed with test */
+				dist = topology_distance(tst, my_rank, partner_rank);
+				nfam = net_families(tst, dist, placement_distance(tst, my_rank, partner_rank), fam);
 				ierr = 0;
 				/***************************************/
 				/* warm-up / pre-synchronize this pair */
@@ -254,95 +599,306 @@ void net_MPI_test(test_p tst, measurement_p m) {
 					ORB_read(t3);
 				}
 				assert(ierr == 0);
-				/************************************************************/
-				/* BEGIN PERFORMANCE KERNEL -- gather samples for this pair */
-				/************************************************************/
-				for (i = 0; i < tst->num_messages; i++) {
-					/* for timer overhead estimate */
-					ORB_read(t1);
-					ORB_read(t2);
-					/***************************************/
-					/* begin timed communication primitive */
-					/***************************************/
-					ierr += MPI_Sendrecv(sbuf->data, m->buflen, MPI_BYTE, partner_rank, 0,
-							     rbuf->data, m->buflen, MPI_BYTE, partner_rank, 0,
+				/* where the partner's clock is as the pair starts */
+				if (tst->oneway)
+					net_MPI_sync(partner_rank, t0, s0);
+				/* the pair's minimums span all of its chunks */
+				cosmin = cpwmin = owmin = ~((ORB_tick_t)0);
+				for (c0 = 0; c0 < tst->num_messages; c0 += n) {
+					n = tst->num_messages - c0;
+					if (n > chunk)
+						n = chunk;
+					/*************************************************************/
+					/* BEGIN PERFORMANCE KERNEL -- gather a chunk of samples     */
+					/*************************************************************/
+					for (i = 0; i < n; i++) {
+						/* for timer overhead estimate */
+						ORB_read(t1);
+						ORB_read(t2);
+						/***************************************/
+						/* begin timed communication primitive */
+						/***************************************/
+						ierr += MPI_Sendrecv(sbuf->data, m->buflen, MPI_BYTE, partner_rank, 0,
+								     rbuf->data, m->buflen, MPI_BYTE, partner_rank, 0,
+								     MPI_COMM_WORLD, &mpistatus);
+						/*************************************/
+						/* end timed communication primitive */
+						/*************************************/
+						ORB_read(t3);
+						/* save the timings in ticks, convert when binning */
+						t[i] = ORB_cycles(t2, t1);
+						cos[i] = ORB_cycles(t3, t2);
+						if (ts != NULL)
+							ts[i] = ORB_cycles_u(t2, t0);
+						if (te != NULL)
+							te[i] = ORB_cycles_u(t3, t0);
+					}
+					/*************************************************************/
+					/* END PERFORMANCE KERNEL -- chunk of samples gathered       */
+					/*************************************************************/
+					assert(ierr == 0);
+					/* and again after the chunk, for the drift across it */
+					if (tst->oneway)
+						net_MPI_sync(partner_rank, t0, s1);
+					/* exchange the chunk of local timings with partner */
+					net_pack(cos, xos, n);
+					ierr += MPI_Sendrecv(xos, n, MPI_UNSIGNED, partner_rank, 0,
+							     xpw, n, MPI_UNSIGNED, partner_rank, 0,
 							     MPI_COMM_WORLD, &mpistatus);
-					/*************************************/
-					/* end timed communication primitive */
-					/*************************************/
-					ORB_read(t3);
-					/* save the timings */
-					t[i] = ORB_seconds(t2, t1);
-					cos[i] = ORB_seconds(t3, t2);
+					assert(ierr == 0);
+					net_unpack(xpw, cpw, n, partner_rank);
+					/* pairwise as average, comparable to one-sided */
+					net_pairwise(tst, cos, cpw, n);
+					/* bin the t, cos, and cpw results for this chunk */
+					net_measurement_bin(tst, m, t, cos, cpw, n, nfam, fam, &cosmin, &cpwmin);
+					/* and fold them into this partner's summary */
+					if (m->pairs != NULL)
+						pairs_add(tst, m->pairs, partner_rank, cpw, n);
+					/* and stream the raw samples */
+					if (tr != NULL)
+						trace_stage(tr, ts, cos, cpw, n, partner_rank, icycle);
+					/* and log the slow ones */
+					if (m->outliers != NULL)
+						outlier_ticks(tst, m->outliers, ts, cos, n, partner_rank, icycle, istage);
+					/* one-way from the partner's send start to this rank's receive */
+					if (tst->oneway) {
+						ierr += MPI_Sendrecv(ts, n, MPI_UNSIGNED_LONG_LONG, partner_rank, 0,
+								     tp, n, MPI_UNSIGNED_LONG_LONG, partner_rank, 0,
+								     MPI_COMM_WORLD, &mpistatus);
+						assert(ierr == 0);
+						net_oneway(tst, te, tp, cow, n, s0, s1);
+						net_oneway_bin(tst, m, cow, n, dist, &owmin, &owskip);
+						if (m->oneway != NULL)
+							pairs_add(tst, m->oneway, partner_rank, cow, n);
+						s0[0] = s1[0];
+						s0[1] = s1[1];
+					}
 				}
-				/************************************************************/
-				/* END PERFORMANCE KERNEL -- samples gathered for this pair */
-				/************************************************************/
-				assert(ierr == 0);
-				/* exchange array of local timings with partner */
-				ierr += MPI_Sendrecv(cos, tst->num_messages, MPI_DOUBLE, partner_rank, 0,
-						     cpw, tst->num_messages, MPI_DOUBLE, partner_rank, 0,
-						     MPI_COMM_WORLD, &mpistatus);
-				assert(ierr == 0);
-				/* pairwise as average, comparable to one-sided */
-				for (i = 0; i < tst->num_messages; i++) {
-					cpw[i] = (cpw[i] + cos[i]) / 2.0;
+				/* bin the minimums for this cycle of this pair */
+				net_measurement_binmin(tst, m, cosmin, cpwmin, nfam, fam);
+				if (tst->oneway)
+					net_oneway_binmin(tst, m, owmin, dist);
+
+				/* run the pair again with each thread count */
+				for (k = 0; k < tst->num_thread_counts; k++) {
+					for (j = 0; j < tst->thread_counts[k]; j++) {
+						th[j].partner_rank = partner_rank;
+						th[j].nfam = 1;
+						th[j].fam[0] = net_thread_family(tst, k, dist);
+						ierr += pthread_create(&th[j].id, NULL, net_MPI_thread, &th[j]);
+					}
+					for (j = 0; j < tst->thread_counts[k]; j++)
+						ierr += pthread_join(th[j].id, NULL);
+					assert(ierr == 0);
 				}
-				/* bin the t, cos, and cpw results for this cycle of this pair in p */
-				net_measurement_bin(tst, m, t, cos, cpw, (node_id[my_rank] == node_id[partner_rank]));
 			} /* if valid pairing */
 		} /* for istage */
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
 	} /* for icycle */
+	/* merge the thread-local histograms before aggregation */
+	for (j = 0; j < max_threads; j++) {
+		measurement_merge(m, th[j].m);
+		net_thread_free(&th[j]);
+	}
+	if (th != NULL)
+		free(th);
+	if (tr != NULL)
+		tr = trace_close(tr);
+	if (ts != NULL)
+		free(ts);
+	if (te != NULL) {
+		/* negative one-way times mean the offset was off by more than the latency */
+		ierr = MPI_Reduce(&owskip, &owskipped, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, root_rank, MPI_COMM_WORLD);
+		assert(ierr == 0);
+		if ((my_rank == root_rank) && (owskipped > 0))
+			printf("Confidence: %"PRIu64" one-way sample(s) below zero or invalid, not binned\n", owskipped);
+		free(te);
+		free(tp);
+		free(cow);
+	}
 	free(t);
 	free(cpw);
+	free(xos);
 	free(cos);
-	comm_freebuffer(rbuf);
-	comm_freebuffer(sbuf);
 #endif
 	return;
 }
 
 /**
- \brief Converts the time measurements to bin
+ \brief Narrows one-sided timings to 32-bit tick deltas for the partner
+ \param c Timings (ticks)
+ \param x Filled with the timings, saturated at TICK32_MAX, TICK32_INVALID if invalid
+ \param n Number of timings
 */
-void net_measurement_bin(test_p tst, measurement_p m, double *t, double *cos, double *cpw, int LOCAL) {
-	double cosmin, cpwmin;
-	uint64_t *ptimd, *posd, *ppwd, *posmd, *ppwmd;
+void net_pack(ORB_tick_t *c, uint32_t *x, int n) {
 	int i;
-	if (LOCAL) { /* bin these values as local communication */
-		posd = m->hist[onNodeOnesided].dist;
-		ppwd = m->hist[onNodePairwise].dist;
-		posmd = m->hist[onNodeOnesidedMinimum].dist;
-		ppwmd = m->hist[onNodePairwiseMinimum].dist;
-	} else { /* bin these values as remote communication */
-		posd = m->hist[offNodeOnesided].dist;
-		ppwd = m->hist[offNodePairwise].dist;
-		posmd = m->hist[offNodeOnesidedMinimum].dist;
-		ppwmd = m->hist[offNodePairwiseMinimum].dist;
+	for (i = 0; i < n; i++) {
+		if (!TICK_VALID(c[i]))
+			x[i] = TICK32_INVALID;
+		else if (c[i] > TICK32_MAX)
+			x[i] = TICK32_MAX;
+		else
+			x[i] = (uint32_t)c[i];
 	}
-	ptimd = m->hist[timer].dist;
-	cosmin = cpwmin = 1.0e+16;
-	for (i = 0; i < tst->num_messages; i++) {
+}
+
+/**
+ \brief Widens the partner's 32-bit tick deltas back to timings in this rank's ticks
+ \param x Timings as received from the partner, in its ticks
+ \param c Filled with the timings (ticks), invalid ones restored
+ \param n Number of timings
+ \param partner Rank of the partner, whose timer may run at another rate (rank_freq[])
+*/
+void net_unpack(uint32_t *x, ORB_tick_t *c, int n, int partner) {
+	double scale = (rank_freq[partner] > 0.0) ? ORB_REFFREQ / rank_freq[partner] : 1.0;
+	int i;
+	for (i = 0; i < n; i++) {
+		if (x[i] == TICK32_INVALID)
+			c[i] = ~((ORB_tick_t)0);
+		else if (scale == 1.0)
+			c[i] = (ORB_tick_t)x[i];
+		else
+			c[i] = (ORB_tick_t)((double)x[i] * scale + 0.5);
+	}
+}
+
+/**
+ \brief Combines the partner's one-sided timings into pairwise timings
+ \param cos This rank's one-sided timings (ticks)
+ \param cpw On entry the partner's one-sided timings, on exit the pairwise average
+ \param n Number of timings
+*/
+void net_pairwise(test_p tst, ORB_tick_t *cos, ORB_tick_t *cpw, int n) {
+	int i;
+	for (i = 0; i < n; i++) {
+		/* an invalid sample on either side invalidates the pair */
+		if (TICK_VALID(cos[i]) && TICK_VALID(cpw[i]))
+			cpw[i] = (cpw[i] + cos[i]) / 2;
+		else
+			cpw[i] = ~((ORB_tick_t)0);
+	}
+}
+
+/**
+ \brief Finds the histogram families a pair is binned in
+ \param dist Distance class of the pair (topology_distance())
+ \param place Placement class of an on-node pair (placement_distance())
+ \param fam Filled with the first histogram of each family
+ \return Number of families
+*/
+int net_families(test_p tst, int dist, int place, int *fam) {
+	int nfam = 1;
+	/* bin these values as local or remote communication, */
+	fam[0] = (dist == TOPO_NODE) ? onNodeOnesided : offNodeOnesided;
+	/* and again in the family of their distance class */
+	if ((tst->topo_coord != NULL) && (dist > TOPO_NODE))
+		fam[nfam++] = NET_LEN + NET_FAMILY * (dist - TOPO_SWITCH);
+	/* or of their placement class */
+	if ((tst->place_coord != NULL) && (place > PLACE_UNKNOWN))
+		fam[nfam++] = NET_PLACE_BASE(tst) + NET_FAMILY * place;
+	return nfam;
+}
+
+/**
+ \brief Finds the histogram family a pair is binned in when run with threads
+ \param k Index of the thread count in tst->thread_counts
+ \param dist Distance class of the pair (topology_distance())
+*/
+int net_thread_family(test_p tst, int k, int dist) {
+	return NET_THREAD_BASE(tst) + k * NET_THREAD_LEN + ((dist == TOPO_NODE) ? 0 : NET_FAMILY);
+}
+
+/**
+ \brief Converts a chunk of time measurements (in timer ticks) to bin
+ \param n Number of timings in the chunk
+ \param nfam,fam Histogram families of the pair (net_families())
+ \param cosmin,cpwmin Running minimums of the pair, updated
+*/
+void net_measurement_bin(test_p tst, measurement_p m, ORB_tick_t *t, ORB_tick_t *cos, ORB_tick_t *cpw, int n,
+			 int nfam, int *fam, ORB_tick_t *cosmin, ORB_tick_t *cpwmin) {
+	int i, f;
+	for (i = 0; i < n; i++) {
 		/* bin the individual results */
 		if (t != NULL) {
-			if (t[i] >= 0.0)
-				ptimd[time2bin(tst,t[i])]++;
+			if (TICK_VALID(t[i]))
+				MEASUREMENT_BIN(m, timer, tick2bin(tst,t[i]))++;
+		}
+		for (f = 0; f < nfam; f++) {
+			if (TICK_VALID(cos[i]))
+				MEASUREMENT_BIN(m, fam[f], tick2bin(tst,cos[i]))++;
+			if (TICK_VALID(cpw[i]))
+				MEASUREMENT_BIN(m, fam[f] + NET_PW, tick2bin(tst,cpw[i]))++;
 		}
-		if (cos[i] >= 0.0)
-			posd[time2bin(tst,cos[i])]++;
-		if (cpw[i] >= 0.0)
-			ppwd[time2bin(tst,cpw[i])]++;
-		/* save the minimums for now */
-		if ((cos[i] > 0.0) && (cos[i] < cosmin))
-			cosmin = cos[i];
-		if ((cpw[i] > 0.0) && (cpw[i] < cpwmin))
-			cpwmin = cpw[i];
+		/* save the minimums for now (invalid samples compare high) */
+		if ((cos[i] > 0) && (cos[i] < *cosmin))
+			*cosmin = cos[i];
+		if ((cpw[i] > 0) && (cpw[i] < *cpwmin))
+			*cpwmin = cpw[i];
 	}
-	/* now bin the minimums for this communications pair */
-	if (cosmin > 0.0)
-		posmd[time2bin(tst,cosmin)]++;
-	if (cpwmin > 0.0)
-		ppwmd[time2bin(tst,cpwmin)]++;
 }
 
+/**
+ \brief Bins the minimums of a communications pair, once all its chunks are binned
+*/
+void net_measurement_binmin(test_p tst, measurement_p m, ORB_tick_t cosmin, ORB_tick_t cpwmin, int nfam, int *fam) {
+	int f;
+	for (f = 0; f < nfam; f++) {
+		if (TICK_VALID(cosmin))
+			MEASUREMENT_BIN(m, fam[f] + NET_MIN, tick2bin(tst,cosmin))++;
+		if (TICK_VALID(cpwmin))
+			MEASUREMENT_BIN(m, fam[f] + NET_PW + NET_MIN, tick2bin(tst,cpwmin))++;
+	}
+}
 
+/**
+ \brief Converts the partner's sample start times into one-way latencies to this rank
+ \param te This rank's sample end times (ticks since its origin)
+ \param tp The partner's sample start times (ticks since its origin)
+ \param cow Filled with the one-way timings (ticks); invalid (~0) when the
+ offset is off by more than the latency, so that the timing is below zero
+ \param n Number of timings
+ \param s0,s1 Clock offsets before and after the samples (net_MPI_sync()),
+ interpolated linearly for the drift between them
+*/
+void net_oneway(test_p tst, ORB_tick_t *te, ORB_tick_t *tp, ORB_tick_t *cow, int n, double *s0, double *s1) {
+	double drift, ow;
+	int i;
+	drift = (s1[0] > s0[0]) ? (s1[1] - s0[1]) / (s1[0] - s0[0]) : 0.0;
+	for (i = 0; i < n; i++) {
+		/* the partner's start on this rank's clock, less the timer's own latency */
+		ow = (double)te[i] - ((double)tp[i] - (s0[1] + drift * ((double)te[i] - s0[0]))) - (double)ORB_min_lat_cyc;
+		if (TICK_VALID(te[i]) && TICK_VALID(tp[i]) && (ow >= 0.0))
+			cow[i] = (ORB_tick_t)(ow + 0.5);
+		else
+			cow[i] = ~((ORB_tick_t)0);
+	}
+}
+
+/**
+ \brief Bins a chunk of one-way timings in the on-node or off-node one-way histogram
+ \param dist Distance class of the pair (topology_distance())
+ \param owmin Running minimum of the pair, updated
+ \param owskip Count of invalid timings, which are not binned, updated
+*/
+void net_oneway_bin(test_p tst, measurement_p m, ORB_tick_t *cow, int n, int dist, ORB_tick_t *owmin, uint64_t *owskip) {
+	int i, h = NET_ONEWAY_BASE(tst) + ((dist == TOPO_NODE) ? 0 : 2);
+	for (i = 0; i < n; i++) {
+		if (!TICK_VALID(cow[i])) {
+			(*owskip)++;
+			continue;
+		}
+		MEASUREMENT_BIN(m, h, tick2bin(tst,cow[i]))++;
+		if (cow[i] < *owmin)
+			*owmin = cow[i];
+	}
+}
+
+/**
+ \brief Bins the one-way minimum of a communications pair, once all its chunks are binned
+*/
+void net_oneway_binmin(test_p tst, measurement_p m, ORB_tick_t owmin, int dist) {
+	if (TICK_VALID(owmin))
+		MEASUREMENT_BIN(m, NET_ONEWAY_BASE(tst) + ((dist == TOPO_NODE) ? 0 : 2) + 1, tick2bin(tst,owmin))++;
+}
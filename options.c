@@ -27,29 +27,73 @@
 #include <unistd.h>
 #include <math.h>
 #include <getopt.h>
+#include <limits.h>
 
 #include "tests.h"
 #include "types.h"
 #include "options.h"
 #include "comm.h"
+#include "measurement.h"
+#include "topology.h"
+#include "placement.h"
+#include "outlier.h"
 #ifdef USE_XDD
 #include "xdd_main.h"
 #endif
 
+/* most threads per rank in the threaded net test */
+#define MAX_THREADS 256
+
+/* default net test chunk: 4 arrays of 8-byte ticks stay within 2 MB */
+#define NET_CHUNK 65536
+
+/* cycle cap for adaptive sampling when neither -C nor -T bound it */
+#define ADAPTIVE_MAX_CYCLES 1000
+
 /**
  * defaults for command line options
  */
 void setdefaults(test_p tst) {
 	tst->num_messages = 100000;	/* messages per cycle */
-	tst->num_cycles = 10;		/* cycles -- future: time limit the data collection */
+	tst->num_cycles = 10;		/* cycles, or the cap on cycles with a time limit */
+	tst->time_limit = 0.0;		/* no time limit on data collection */
+	tst->ci_tolerance = 0.0;	/* no adaptive sampling */
+	tst->num_quantiles = 3;		/* adaptive sampling watches the median and the tail */
+	tst->quantiles[0] = 0.5;
+	tst->quantiles[1] = 0.99;
+	tst->quantiles[2] = 0.999;
+	tst->chunk = NET_CHUNK;		/* bounds the net test's timing arrays */
+	tst->num_thread_counts = 0;	/* single-threaded ranks only */
+	tst->fwq_quantum = 100.0e-6;	/* fixed work quantum of the FWQ test */
+	tst->mem_node = -1;		/* memory test: working sets in local memory */
 	tst->num_warmup = 100;	/* keep this < 1% of tst->num_messages */
+	tst->window = 64;		/* messages in flight per window */
 	/* tst->total_messages = (uint64_t)(tst->num_cycles) *
 		(uint64_t)(tst->num_messages) * (uint64_t)(num_ranks-1); */
 	tst->buf_len = 1;		/* small message */
+	tst->buf_lens = NULL;		/* no sweep unless -B gives several sizes */
+	tst->num_buf_lens = 0;
+	tst->calibrated = 0;
 	tst->num_bins = 1000;		/* with log binning, don't need much more */
 	tst->bin_size = 50.0e-9;	/* 50ns works well with x86_64 assm timers */
-	tst->log_binning = 0;		/* linear binning */
+	tst->log_binning = BIN_LINEAR;	/* linear binning */
+	tst->hist_layout = LAYOUT_HISTMAJOR;	/* each histogram contiguous */
+	tst->subbucket_bits = 5;	/* log-linear: 32 bins per octave, ~3% resolution */
 	tst->rank_mapping = 0;
+	tst->reduce_root = 0;		/* every rank gets the global result */
+	tst->pair_matrix = 0;		/* no per-partner summaries */
+	tst->dense_output = 0;		/* omit empty bins from the HIST/PDF/CDF files */
+	tst->oneway = 0;		/* round trips only, no clock offsets */
+	tst->suspect_k = 0.0;		/* no suspects report */
+	tst->trace = 0;			/* no raw sample trace */
+	tst->outlier_threshold = 0.0;	/* no outlier log */
+	tst->outlier_events = OUTLIER_EVENTS;
+	tst->schedule = SCHED_XOR;	/* power-of-2 XOR pairing */
+	tst->topo_file = NULL;		/* on-node/off-node only */
+	tst->topo_coord = NULL;
+	tst->pin_policy = PIN_OFF;	/* launcher's binding, on-node/off-node only */
+	tst->place_coord = NULL;
+	tst->cal_file = NULL;		/* no calibration cache unless ORB_CALIBRATION_CACHE is set */
 	tst->test_type = 0;		/* no test defined */
 	strcpy(tst->case_name, "OUTPUT_DIRECTORY");	/* user should replace */
 	tst->argc = 0;
@@ -58,26 +102,70 @@ void setdefaults(test_p tst) {
 	tst->tsdump = NULL;
 }
 
+/**
+ * \brief looks for an option before the options are parsed, the way getopt() would see it
+ * \return 1 if opt is given, 0 if not
+ *
+ * Option letters may be grouped (-Pp2), values of the options that take
+ * one are skipped whether attached (-k-p) or separate (-k -p), and "--"
+ * ends the options.
+ */
+int option_given(int argc, char *argv[], char opt) {
+	char *a, *o;
+	int i;
+	for (i = 1; i < argc; i++) {
+		a = argv[i];
+		if ((a[0] != '-') || (a[1] == '\0'))
+			continue;	/* not an option */
+		if (strcmp(a, "--") == 0)
+			break;
+		for (a++; *a != '\0'; a++) {
+			if (*a == opt)
+				return 1;
+			o = strchr(OPTIONS, *a);
+			if ((o != NULL) && (o[1] == ':')) {
+				if (a[1] == '\0')
+					i++;	/* the value is the next argument */
+				break;
+			}
+		}
+	}
+	return 0;
+}
+
 /**
  * \brief parse command line options without seatbelts/sanity/consistency checks.
  * \return number of arguments found
  */
 void general_options(test_p tst, int argc, char *argv[]) {
-	int ierr, opt, printhelp;
+	int ierr, opt, printhelp, cycles_given;
 	extern char *optarg;
 	extern int optind, opterr, optopt;
 	setdefaults(tst);
 	printhelp = 0;
+	cycles_given = 0;
 	ierr = 0;
 
 	/* parse test names and common options */
-	while ((opt = getopt(argc, argv, "t:m:n:w:N:lrhB:C:G:M:W:X:")) != -1) {
+	while ((opt = getopt(argc, argv, OPTIONS)) != -1) {
 		switch (opt) {
 			case 't':
 				if (strcmp(optarg,"net")==0) {
 					tst->test_type = NET_TEST;
 				} else if (strcmp(optarg,"bit")==0) {
 					tst->test_type = BIT_TEST;
+				} else if (strcmp(optarg,"win")==0) {
+					tst->test_type = WIN_TEST;
+				} else if (strcmp(optarg,"coll")==0) {
+					tst->test_type = COLL_TEST;
+				} else if (strcmp(optarg,"c2c")==0) {
+					tst->test_type = C2C_TEST;
+				} else if (strcmp(optarg,"fwq")==0) {
+					tst->test_type = FWQ_TEST;
+				} else if (strcmp(optarg,"mem")==0) {
+					tst->test_type = MEM_TEST;
+				} else if (strcmp(optarg,"timer")==0) {
+					tst->test_type = TIMER_TEST;
 #ifdef USE_XDD
 				} else if (strcmp(optarg,"io")==0) {
 					tst->test_type = IO_TEST;
@@ -88,11 +176,51 @@ void general_options(test_p tst, int argc, char *argv[]) {
 				}
 				break;
 			case 'l':
-				tst->log_binning = 1;
+				tst->log_binning = BIN_LOG;
+				break;
+			case 'A':
+				if (strcmp(optarg,"hist")==0) {
+					tst->hist_layout = LAYOUT_HISTMAJOR;
+				} else if (strcmp(optarg,"bin")==0) {
+					tst->hist_layout = LAYOUT_BINMAJOR;
+				} else {
+					fprintf(stderr,"Layout %s unrecognized!\n",optarg);
+					ierr++;
+				}
+				break;
+			case 'D':
+				tst->topo_file = strdup(optarg);
+				assert(tst->topo_file != NULL);
+				break;
+			case 'L':
+				tst->log_binning = BIN_LOGLINEAR;
+				tst->subbucket_bits = strtol(optarg, NULL, 0);
+				if ((tst->subbucket_bits < 1) || (tst->subbucket_bits > 20))
+					ierr++;
 				break;
 			case 'r':
 				tst->rank_mapping = 1;
 				break;
+			case 'R':
+				tst->reduce_root = 1;
+				break;
+			case 'a':
+				if (strcmp(optarg,"none")==0) {
+					tst->pin_policy = PIN_NONE;
+				} else if (strcmp(optarg,"compact")==0) {
+					tst->pin_policy = PIN_COMPACT;
+				} else if (strcmp(optarg,"scatter")==0) {
+					tst->pin_policy = PIN_SCATTER;
+				} else {
+					fprintf(stderr,"Affinity policy %s unrecognized!\n",optarg);
+					ierr++;
+				}
+				break;
+			case 'c':
+				tst->chunk = strtol(optarg, NULL, 0);
+				if (tst->chunk <= 0)
+					ierr++;
+				break;
 			case 'n':
 				tst->num_bins = strtol(optarg, NULL, 0);
 				if (tst->num_bins == 0)
@@ -113,24 +241,96 @@ void general_options(test_p tst, int argc, char *argv[]) {
 				if (strlen(tst->case_name) == 0)
 					ierr++;
 				break;
+			case 'F':
+				tst->suspect_k = strtod(optarg, NULL);
+				if (tst->suspect_k <= 0.0)
+					ierr++;
+				break;
+			case 'k':
+				if (tst->cal_file != NULL)
+					free(tst->cal_file);
+				tst->cal_file = strdup(optarg);
+				assert(tst->cal_file != NULL);
+				break;
+			case 'p':
+				ierr += parse_thread_counts(tst, optarg);
+				break;
+			case 'q':
+				tst->fwq_quantum = strtod(optarg, NULL);
+				if (tst->fwq_quantum <= 0.0)
+					ierr++;
+				break;
+			case 'u':
+				tst->mem_node = strtol(optarg, NULL, 0);
+				if ((tst->mem_node < 0) || (tst->mem_node >= MEM_MAX_NODES))
+					ierr++;
+				break;
+			case 'O':
+				tst->trace = 1;
+				break;
+			case 'P':
+				tst->pair_matrix = 1;
+				break;
+			case 'd':
+				tst->dense_output = 1;
+				break;
+			case 's':
+#ifdef SHMEM
+				/* a get is a round trip, there is no one-way time to split off */
+				ROOTONLY fprintf(stderr, "One-way latencies (-s) need the MPI net test\n");
+				ierr++;
+#else
+				tst->oneway = 1;
+#endif
+				break;
 			case 'h':
 				printhelp = 1;
 				break;
 			case 'B':
-				tst->buf_len = strtol(optarg, NULL, 0);
-				if (tst->buf_len == 0)
-					ierr++;
+				ierr += parse_buf_lens(tst, optarg);
 				break;
 			case 'C':
 				tst->num_cycles = strtol(optarg, NULL, 0);
 				if (tst->num_cycles == 0)
 					ierr++;
+				cycles_given = 1;
+				break;
+			case 'E':
+				tst->ci_tolerance = strtod(optarg, NULL);
+				if ((tst->ci_tolerance <= 0.0) || (tst->ci_tolerance >= 1.0))
+					ierr++;
+				break;
+			case 'K':
+				tst->window = strtol(optarg, NULL, 0);
+				if (tst->window <= 0)
+					ierr++;
 				break;
 			case 'M':
 				tst->num_messages = strtol(optarg, NULL, 0);
 				if (tst->num_messages == 0)
 					ierr++;
 				break;
+			case 'Q':
+				ierr += parse_quantiles(tst, optarg);
+				break;
+			case 'S':
+				if (strcmp(optarg,"xor")==0) {
+					tst->schedule = SCHED_XOR;
+				} else if (strcmp(optarg,"rr")==0) {
+					tst->schedule = SCHED_ROUNDROBIN;
+				} else {
+					fprintf(stderr,"Schedule %s unrecognized!\n",optarg);
+					ierr++;
+				}
+				break;
+			case 'T':
+				tst->time_limit = strtod(optarg, NULL);
+				if (tst->time_limit <= 0.0)
+					ierr++;
+				break;
+			case 'U':
+				ierr += parse_outliers(tst, optarg);
+				break;
 			case 'W':
 				tst->num_warmup = strtol(optarg, NULL, 0);
 				if (tst->num_warmup == 0)
@@ -160,12 +360,60 @@ void general_options(test_p tst, int argc, char *argv[]) {
 		exit(1);
 	}
 
+	/* threaded ranks need MPI_THREAD_MULTIPLE, see comm_MPI_initialize() */
+	if (tst->num_thread_counts > 0) {
+		if (tst->test_type != NET_TEST) {
+			ROOTONLY fprintf(stderr, "Threads per rank (-p) apply to the net test only!\n");
+			exit(1);
+		}
+		if (!thread_multiple) {
+			ROOTONLY fprintf(stderr, "Threads per rank (-p) need MPI_THREAD_MULTIPLE, which this MPI does not provide!\n");
+			exit(1);
+		}
+	}
+
 	/* if no options were passed for the IO test, just pass program name */
 	if ((tst->test_type==IO_TEST) && (tst->argc==0)) {
 		parse_xdd_args(tst, "", argv[0]);
 	}
 
-	if (tst->log_binning == 1) {
+	/* a single message size unless -B asked for more */
+	if (tst->num_buf_lens == 0)
+		add_buf_len(tst, tst->buf_len);
+	tst->buf_len = tst->buf_lens[0];
+
+	/* the time limit is shared evenly by the message sizes; -C caps the cycles */
+	if (tst->time_limit > 0.0) {
+		tst->time_limit /= tst->num_buf_lens;
+		if (!cycles_given)
+			tst->num_cycles = INT_MAX;
+	} else if ((tst->ci_tolerance > 0.0) && !cycles_given) {
+		/* adaptive sampling still needs a bound */
+		tst->num_cycles = ADAPTIVE_MAX_CYCLES;
+	}
+
+	/* stages in one pass of the all-pairs schedule */
+	tst->num_stages = comm_num_stages(tst);
+
+	/* calibration cache shared by runs on the same CPU model and kernel */
+	if ((tst->cal_file == NULL) && (getenv("ORB_CALIBRATION_CACHE") != NULL)) {
+		tst->cal_file = strdup(getenv("ORB_CALIBRATION_CACHE"));
+		assert(tst->cal_file != NULL);
+	}
+
+	/* distance classes of the off-node pairs */
+	if (tst->topo_file != NULL)
+		topology_load(tst);
+
+	/* pinning, and the placement classes of the on-node pairs */
+	if (tst->pin_policy != PIN_OFF)
+		placement_load(tst);
+
+	if (tst->log_binning == BIN_LOGLINEAR) {
+		/* bins are in timer ticks, the range is known after ORB_calibrate() */
+		tst->max_hist_time = 0.0;
+		tst->hist_scale = 0.0;
+	} else if (tst->log_binning == BIN_LOG) {
 		tst->max_hist_time = 1.0;
 		tst->hist_scale = ((double)tst->num_bins) / log(tst->max_hist_time / tst->bin_size);
 	} else {		/* LINEAR binning */
@@ -175,6 +423,146 @@ void general_options(test_p tst, int argc, char *argv[]) {
 }
 
 
+/** \brief appends a message size to the sweep */
+void add_buf_len(test_p tst, int len) {
+	tst->buf_lens = realloc(tst->buf_lens, (tst->num_buf_lens+1)*sizeof(int));
+	assert(tst->buf_lens);
+	tst->buf_lens[tst->num_buf_lens++] = len;
+}
+
+/** \brief parses a size with an optional K, M or G (powers of 1024) suffix */
+static long parse_size(char *str, char **end) {
+	long n = strtol(str, end, 0);
+	switch (**end) {
+		case 'k': case 'K': n <<= 10; (*end)++; break;
+		case 'm': case 'M': n <<= 20; (*end)++; break;
+		case 'g': case 'G': n <<= 30; (*end)++; break;
+	}
+	return n;
+}
+
+/**
+ * \brief parses a list of thread counts per rank, eg. 2,4,8
+ * \return number of errors found
+ */
+int parse_thread_counts(test_p tst, char *optarg) {
+	char *p, *end;
+	long n;
+	tst->num_thread_counts = 0;
+	p = optarg;
+	while (*p != '\0') {
+		n = strtol(p, &end, 0);
+		if ((end == p) || (n < 2) || (n > MAX_THREADS) || (tst->num_thread_counts == MAX_THREAD_COUNTS)) {
+			ROOTONLY fprintf(stderr, "Thread count list %s unrecognized (at most %d, each from 2 to %d)!\n",
+					 optarg, MAX_THREAD_COUNTS, MAX_THREADS);
+			return 1;
+		}
+		tst->thread_counts[tst->num_thread_counts++] = (int)n;
+		p = end;
+		if (*p == ',')
+			p++;
+		else if (*p != '\0') {
+			ROOTONLY fprintf(stderr, "Thread count list %s unrecognized!\n", optarg);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * \brief parses the outlier log option: <seconds>|auto[,<events>]
+ * \return number of errors found
+ */
+int parse_outliers(test_p tst, char *optarg) {
+	char *end;
+	if (strncmp(optarg, "auto", 4) == 0) {
+		tst->outlier_threshold = OUTLIER_AUTO;
+		end = optarg + 4;
+	} else {
+		tst->outlier_threshold = strtod(optarg, &end);
+		if ((end == optarg) || (tst->outlier_threshold <= 0.0)) {
+			ROOTONLY fprintf(stderr, "Outlier threshold %s unrecognized!\n", optarg);
+			return 1;
+		}
+	}
+	if (*end == ',') {
+		tst->outlier_events = strtol(end + 1, &end, 0);
+		if (tst->outlier_events <= 0) {
+			ROOTONLY fprintf(stderr, "Outlier ring size in %s unrecognized!\n", optarg);
+			return 1;
+		}
+	}
+	return (*end != '\0');
+}
+
+/**
+ * \brief parses a comma separated list of quantiles for adaptive sampling
+ *
+ * each entry must lie strictly between 0 and 1, eg. '0.5,0.99,0.999'
+ * \return number of errors found
+ */
+int parse_quantiles(test_p tst, char *optarg) {
+	char *p, *end;
+	double q;
+	tst->num_quantiles = 0;
+	p = optarg;
+	while (*p != '\0') {
+		q = strtod(p, &end);
+		if ((end == p) || (q <= 0.0) || (q >= 1.0) || (tst->num_quantiles == MAX_QUANTILES)) {
+			ROOTONLY fprintf(stderr, "Quantile list %s unrecognized (at most %d, each in (0,1))!\n",
+					 optarg, MAX_QUANTILES);
+			return 1;
+		}
+		tst->quantiles[tst->num_quantiles++] = q;
+		p = end;
+		if (*p == ',')
+			p++;
+		else if (*p != '\0') {
+			ROOTONLY fprintf(stderr, "Quantile list %s unrecognized!\n", optarg);
+			return 1;
+		}
+	}
+	return (tst->num_quantiles == 0);
+}
+
+/**
+ * \brief parses a comma separated list of message sizes and ranges
+ *
+ * each entry is a size or a range <start>:<end>[:x<factor>|:+<step>],
+ * eg. '8,64,1K' or '8:1M:x2' (the default step is x2)
+ * \return number of errors found
+ */
+int parse_buf_lens(test_p tst, char *optarg) {
+	char *p, *end;
+	char op;
+	long n, start, stop, step;
+	p = optarg;
+	while (*p != '\0') {
+		start = stop = parse_size(p, &end);
+		op = 'x';
+		step = 2;
+		if (*end == ':') {
+			stop = parse_size(end+1, &end);
+			if (*end == ':') {
+				op = *(end+1);
+				step = parse_size(end+2, &end);
+			}
+		}
+		if ((start <= 0) || (stop < start) || (stop > INT_MAX)
+				|| ((op != 'x') && (op != '+'))
+				|| ((op == 'x') && (step < 2)) || ((op == '+') && (step < 1))
+				|| ((*end != ',') && (*end != '\0'))) {
+			fprintf(stderr,"Message sizes %s unrecognized!\n",optarg);
+			return 1;
+		}
+		for (n = start; n <= stop; n = (op == 'x') ? (n * step) : (n + step))
+			add_buf_len(tst, (int)n);
+		p = (*end == ',') ? (end + 1) : end;
+	}
+	return 0;
+}
+
+
 /** \brief tokenizes xdd argument list */
 void parse_xdd_args(test_p tst, char *optarg, char *progname) {
 	char delim = ' ';
@@ -269,23 +657,64 @@ void print_help(test_p tst, char *progname) {
 	fprintf(stderr, "TEST:\n");
 	fprintf(stderr, "\t -t net        \t run the network latency test (confidence)\n");
 	fprintf(stderr, "\t -t bit        \t run the network bit test\n");
+	fprintf(stderr, "\t -t win        \t run the windowed non-blocking bandwidth and message-rate test\n");
+	fprintf(stderr, "\t -t coll       \t run the collective latency test (barrier, allreduce, bcast, alltoall)\n");
+	fprintf(stderr, "\t -t c2c        \t run the core-to-core cache line ping-pong test (one rank per node)\n");
+	fprintf(stderr, "\t -t fwq        \t run the fixed work quantum OS noise test\n");
+	fprintf(stderr, "\t -t mem        \t run the pointer-chasing memory latency test (-B sets the working sets)\n");
+	fprintf(stderr, "\t -t timer      \t compare the overhead and jitter of the timers available on this host\n");
 #ifdef USE_XDD
 	fprintf(stderr, "\t -t io         \t run the I/O test (XDD)\n");
 #endif
 	fprintf(stderr, "COMMON OPTIONS:\n");
 	fprintf(stderr, "\t -N <casename> \t name directory for output (default: %s)\n", tst->case_name);
 	fprintf(stderr, "\t -r            \t save the rank-to-node mapping\n");
+	fprintf(stderr, "\t -R            \t aggregate results on the root rank only (MPI)\n");
 	fprintf(stderr, "\t -l            \t switch from (default) linear binning to logarithmic binning\n");
+	fprintf(stderr, "\t -L <bits>     \t log-linear binning of raw timer ticks, 2^bits bins per octave\n");
 	fprintf(stderr, "\t -w <binwidth> \t width of FIRST histogram bin in seconds (default: %g)\n", tst->bin_size);
 	fprintf(stderr, "\t -m <time>     \t reset maximum message time to bin (log binning only)\n");
 	fprintf(stderr, "\t -n <bins>     \t number of bins in histograms (default: %d)\n", tst->num_bins);
-	fprintf(stderr, "NET/BIT OPTIONS:\n");
+	fprintf(stderr, "\t -a <policy>   \t pin each rank to a CPU: 'compact', 'scatter' (over sockets) or 'none',\n");
+	fprintf(stderr, "\t               \t the net test also bins on-node pairs as same L3, same socket or cross socket\n");
+	fprintf(stderr, "\t -k <file>     \t timer calibration cache: reuse the timer frequency measured by an earlier\n");
+	fprintf(stderr, "\t               \t run on the same CPU model and kernel (default: $ORB_CALIBRATION_CACHE)\n");
+	fprintf(stderr, "\t -d            \t list every bin in the HIST, PDF and CDF files (default: only bins with samples)\n");
+	fprintf(stderr, "\t -A <layout>   \t histogram storage: 'hist' (histogram-major) or 'bin' (bin-major) (default: hist)\n");
+	fprintf(stderr, "NET/BIT/WIN/COLL OPTIONS:\n");
 	fprintf(stderr, "\t -B <buflen>   \t buffer length for message tests in bytes (default: %d)\n", tst->buf_len);
+	fprintf(stderr, "\t               \t a list or range sweeps message sizes in one run (eg. -B 8,64,1K or -B 8:1M:x2)\n");
 	fprintf(stderr, "\t -C <cycles>   \t number of cycles of all-pairs collections (default: %d)\n", tst->num_cycles);
         /* Don't list this option for now, may add back later */
 	/* fprintf(stderr, "\t -G <messages> \t total number of global messages to be exchanged\n"); */
-	fprintf(stderr, "\t -M <messages> \t number of messages to exchange per pair (default: %d)\n", tst->num_messages);
+	fprintf(stderr, "\t -K <window>   \t number of messages in flight per window (win only) (default: %d)\n", tst->window);
+	fprintf(stderr, "\t -M <messages> \t number of messages (windows for win, calls for coll) per pair (default: %d)\n", tst->num_messages);
+	fprintf(stderr, "\t -c <samples>  \t time, exchange and bin net samples in chunks of this many, bounding\n");
+	fprintf(stderr, "\t               \t memory for large -M (net only) (default: %d)\n", tst->chunk);
+	fprintf(stderr, "\t -T <seconds>  \t stop collecting after this many seconds, at a stage boundary\n");
+	fprintf(stderr, "\t               \t (shared by all message sizes; -C then caps the number of cycles)\n");
+	fprintf(stderr, "\t -D <topofile> \t file of '<nodename> <group> <switch>' lines; the net test then also bins\n");
+	fprintf(stderr, "\t               \t off-node pairs by distance: same switch, same group, other group\n");
+	fprintf(stderr, "\t -p <t,t,...>  \t also run each pair with t threads per rank, each on its own tag,\n");
+	fprintf(stderr, "\t               \t binned in a family per thread count (net only, MPI_THREAD_MULTIPLE)\n");
+	fprintf(stderr, "\t -O            \t stream every raw sample to a binary trace file per rank (net only)\n");
+	fprintf(stderr, "\t -P            \t save an N x N matrix of per-pair latency summaries (net only)\n");
+	fprintf(stderr, "\t -s            \t estimate each pair's clock offset and drift, and bin one-way latencies\n");
+	fprintf(stderr, "\t               \t per direction; with -P also an N x N one-way matrix (net only, MPI)\n");
+	fprintf(stderr, "\t -F <k>        \t report pairs, ranks and nodes whose median or p99 is more than k\n");
+	fprintf(stderr, "\t               \t robust deviations above the fleet (net only, eg. -F 5)\n");
+	fprintf(stderr, "\t -E <tol>      \t adaptive sampling: stop after the cycle in which the 95%% confidence\n");
+	fprintf(stderr, "\t               \t intervals of the -Q quantiles are within +/- tol (eg. 0.02 for 2%%)\n");
+	fprintf(stderr, "\t               \t (-C or -T caps the cycles, otherwise %d)\n", ADAPTIVE_MAX_CYCLES);
+	fprintf(stderr, "\t -Q <q,q,...>  \t quantiles watched by adaptive sampling (default: 0.5,0.99,0.999)\n");
+	fprintf(stderr, "\t -S <schedule> \t all-pairs schedule: 'xor' or 'rr' (round-robin, no idle stages) (default: xor)\n");
+	fprintf(stderr, "\t -U <thr>[,n]  \t log samples slower than thr seconds, or than the running p99.9 for\n");
+	fprintf(stderr, "\t               \t thr 'auto', keeping the newest n per rank, the slowest n overall (net and io) (default n: %d)\n", OUTLIER_EVENTS);
 	fprintf(stderr, "\t -W <warmup>   \t number of warm-up messages before timing (default: %d)\n", tst->num_warmup);
+	fprintf(stderr, "FWQ OPTIONS (and -C, -M quanta per cycle, -T, -W):\n");
+	fprintf(stderr, "\t -q <seconds>  \t length of the fixed work quantum (default: %g)\n", tst->fwq_quantum);
+	fprintf(stderr, "MEM OPTIONS (and -B working sets in bytes, -C, -M samples per cycle, -T, -W):\n");
+	fprintf(stderr, "\t -u <node>     \t bind the working sets to this NUMA node (default: local memory)\n");
 #ifdef USE_XDD
 	fprintf(stderr, "IO OPTIONS:\n");
 	fprintf(stderr, "\t -X <xdd_args> \t pass arguments to XDD for the IO test (eg. -X '-target /dev/null')\n");
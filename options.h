@@ -25,6 +25,9 @@
 
 #include "types.h"
 
+/* getopt() option letters, a ':' after the ones that take a value */
+#define OPTIONS "t:a:c:k:m:n:p:q:u:w:A:D:F:L:N:dlOPrRshB:C:E:G:K:M:Q:S:T:U:W:X:"
+
 /**************************************************************
  * FUNCTION PROTOTYPES
  **************************************************************/
@@ -32,7 +35,13 @@
 void setdefaults(test_p tst);
 /* argument parsers */
 void general_options(test_p tst, int argc, char *argv[]);
+int option_given(int argc, char *argv[], char opt);
 void parse_xdd_args(test_p tst, char *optarg, char *progname);
+int parse_buf_lens(test_p tst, char *optarg);
+void add_buf_len(test_p tst, int len);
+int parse_quantiles(test_p tst, char *optarg);
+int parse_outliers(test_p tst, char *optarg);
+int parse_thread_counts(test_p tst, char *optarg);
 /* print help text */
 void print_help(test_p tst, char *progname);
 
@@ -29,27 +29,252 @@
  **************************************************************************/
 
 #include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
+#include <sys/utsname.h>
 #include "config.h"
 
 #define  ORBTIMER_LIBRARY
 #include "orbtimer.h"
 
-static ORB_tick_t Csum = 0;
-static ORB_tick_t Gsum = 0;
-static ORB_tick_t nsamples = 0;
+#if defined(ORB_IS_TSC)
+#   include <cpuid.h>
+#endif
+
+/* overhead sampling: batches of samples, stopping once the estimates settle */
+#define ORB_CAL_BATCH       100000
+#define ORB_CAL_MIN_BATCHES 3
+#define ORB_CAL_MAX_BATCHES 40
+#define ORB_CAL_TOL         0.01
+
+/* frequency discovery: doubling intervals until two estimates agree */
+#define ORB_FREQ_FIRST_USEC 50000
+#define ORB_FREQ_MAX_USEC   5000000
+#define ORB_FREQ_TOL        1.0e-4
+#define ORB_FREQ_TRIES      3	/* measurements before settling for an unverified one */
+#define ORB_FREQ_MAX_CORR   0.01	/* overhead correction, at most this fraction of the interval */
+
+/* calibration cache lines are "<cpu model>|<kernel release>\t<ticks per second>" */
+#define ORB_KEYSIZE 512
+
 static ORB_tick_t ndummy = 0;
 
-void ORB_calibrate() {
-	int i, j;
-	double seconds;
+#if !defined(ORB_IS_FIXEDFREQUENCY)
+/*
+ * Frequency of the timer as the hardware or the kernel reports it,
+ * 0.0 if neither does.
+ */
+static double ORB_reported_freq() {
+#if defined(ORB_IS_TSC)
+	unsigned int a, b, c, d;
+	/* only an invariant TSC ticks at a fixed rate */
+	if (!__get_cpuid(0x80000007, &a, &b, &c, &d) || !(d & (1u << 8)))
+		return 0.0;
+	/* TSC to core crystal ratio and crystal frequency */
+	if (__get_cpuid_max(0, NULL) >= 0x15) {
+		__cpuid(0x15, a, b, c, d);
+		if ((a != 0) && (b != 0) && (c != 0))
+			return (double)c * (double)b / (double)a;
+	}
+	/* under a hypervisor that reports the TSC frequency in kHz */
+	__cpuid(1, a, b, c, d);
+	if (c & (1u << 31)) {
+		__cpuid(0x40000000, a, b, c, d);
+		if (a >= 0x40000010) {
+			__cpuid(0x40000010, a, b, c, d);
+			if (a != 0)
+				return (double)a * 1000.0;
+		}
+	}
+	/* some kernels export their own calibration */
+	{
+		unsigned long khz;
+		FILE *f = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r");
+		if (f != NULL) {
+			if (fscanf(f, "%lu", &khz) == 1) {
+				fclose(f);
+				return (double)khz * 1000.0;
+			}
+			fclose(f);
+		}
+	}
+#elif defined(TIMER_PPC64)
+	/* the time base frequency */
+	char line[256];
+	unsigned long tb;
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	if (f != NULL) {
+		while (fgets(line, sizeof(line), f) != NULL) {
+			if (sscanf(line, "timebase : %lu", &tb) == 1) {
+				fclose(f);
+				return (double)tb;
+			}
+		}
+		fclose(f);
+	}
+#endif
+	return 0.0;
+}
+
+/*
+ * The calibration cache key: CPU model and kernel release.
+ */
+static void ORB_cache_key(char *key) {
+	char line[256], *model = NULL;
+	struct utsname u;
+	FILE *f = fopen("/proc/cpuinfo", "r");
+	key[0] = '\0';
+	if (f != NULL) {
+		while (fgets(line, sizeof(line), f) != NULL) {
+			if ((strncmp(line, "model name", 10) == 0) || (strncmp(line, "cpu\t", 4) == 0)) {
+				model = strchr(line, ':');
+				break;
+			}
+		}
+		fclose(f);
+	}
+	if (model != NULL) {
+		model += 2;
+		model[strcspn(model, "\n")] = '\0';
+	}
+	if (uname(&u) != 0)
+		strcpy(u.release, "unknown");
+	snprintf(key, ORB_KEYSIZE, "%s|%s", (model != NULL) ? model : "unknown", u.release);
+}
+
+/*
+ * Frequency of this key in the calibration cache, 0.0 if missing.
+ */
+static double ORB_cache_read(const char *key) {
+	char line[ORB_KEYSIZE + 64], *tab;
+	double freq = 0.0;
+	FILE *f;
+	if ((ORB_cache_file == NULL) || ((f = fopen(ORB_cache_file, "r")) == NULL))
+		return 0.0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		tab = strrchr(line, '\t');
+		if (tab == NULL)
+			continue;
+		*tab = '\0';
+		if (strcmp(line, key) == 0)
+			freq = strtod(tab + 1, NULL);	/* the last entry wins */
+	}
+	fclose(f);
+	return ORB_FREQ_PLAUSIBLE(freq) ? freq : 0.0;
+}
+
+/*
+ * Adds a measured frequency to the calibration cache, in one write so
+ * that ranks appending at the same time do not interleave.
+ */
+static void ORB_cache_write(const char *key, double freq) {
+	char line[ORB_KEYSIZE + 64];
+	FILE *f;
+	if ((ORB_cache_file == NULL) || ((f = fopen(ORB_cache_file, "a")) == NULL))
+		return;
+	snprintf(line, sizeof(line), "%s\t%.17g\n", key, freq);
+	fputs(line, f);
+	fclose(f);
+}
+
+/*
+ * Measures the frequency against gettimeofday() over doubling intervals,
+ * until two estimates agree to ORB_FREQ_TOL or the longest interval ran.
+ * Sets *ok when they agreed, the interval was no shorter than the sleep,
+ * the overhead correction is small next to it, and the result is a
+ * plausible timer frequency.
+ */
+static double ORB_measure_freq(int *ok) {
 	struct timeval tv1, tv2;
-	ORB_t t1, t2, t3, cycles;
-	ORB_tick_t nsam;
+	ORB_t t1, t2;
+	double seconds, raw, corr, freq, last = 0.0;
+	long usec;
+	int agreed = 0;
+	/* overhead of the region = usleep()+2*ORB()+(0.5+0.5)*gtd() */
+	corr = (double)ORB_avg_lat_cyc + (double)GTD_avg_lat_cyc;
+	for (usec = ORB_FREQ_FIRST_USEC; ; usec *= 2) {
+		gettimeofday(&tv1, 0);
+		ORB_read(t1);
+		usleep(usec);
+		ORB_read(t2);
+		gettimeofday(&tv2, 0);
+		seconds = ((double)(tv2.tv_sec - tv1.tv_sec)) + ((double)(tv2.tv_usec - tv1.tv_usec)) / 1.0e+6;
+		raw = (double)ORB_cycles_u(t2, t1);
+		freq = (seconds > 0.0) ? (raw + corr) / seconds : 0.0;
+		if ((last > 0.0) && (freq > (1.0 - ORB_FREQ_TOL) * last) && (freq < (1.0 + ORB_FREQ_TOL) * last)) {
+			agreed = 1;
+			break;
+		}
+		if (2 * usec > ORB_FREQ_MAX_USEC)
+			break;
+		last = freq;
+	}
+	*ok = agreed && (seconds >= (double)usec / 1.0e+6) && (corr <= ORB_FREQ_MAX_CORR * raw)
+	      && ORB_FREQ_PLAUSIBLE(freq);
+	return freq;
+}
+#endif /* !ORB_IS_FIXEDFREQUENCY */
+
+/*
+ * Median of n values (sorts v).
+ */
+static double ORB_median(double *v, int n) {
+	int i, k;
+	double x;
+	for (i = 1; i < n; i++) {
+		x = v[i];
+		for (k = i; (k > 0) && (v[k - 1] > x); k--)
+			v[k] = v[k - 1];
+		v[k] = x;
+	}
+	return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+/*
+ * Sets the reference frequency and the latencies in seconds that follow from it.
+ */
+void ORB_set_freq(double freq, const char *source) {
+	ORB_ref_freq = freq;
+	ORB_freq_source = source;
+	ORB_avg_lat_sec = ORB_avg_lat_cyc / ORB_ref_freq;
+	ORB_min_lat_sec = ORB_min_lat_cyc / ORB_ref_freq;
+	GTD_avg_lat_sec = GTD_avg_lat_cyc / ORB_ref_freq;
+	GTD_min_lat_sec = GTD_min_lat_cyc / ORB_ref_freq;
+}
+
+/*
+ * Adds a measured frequency that passed every check to the calibration
+ * cache. Values from the hardware, the cache or a failed check are not
+ * written.
+ */
+void ORB_cache_commit() {
+#if !defined(ORB_IS_FIXEDFREQUENCY)
+	char key[ORB_KEYSIZE];
+	if ((ORB_cache_file == NULL) || (strcmp(ORB_freq_source, "measured") != 0))
+		return;
+	ORB_cache_key(key);
+	ORB_cache_write(key, ORB_ref_freq);
+#endif
+}
+
+void ORB_calibrate() {
+	int i, j, nb = 0;
+	ORB_t t1, t2, t3;
+	struct timeval tv1;
+	ORB_tick_t nsam, cprev, gprev;
 	ORB_tick_t cmin, gmin, csum, gsum, c21, c32;
+	double cavg, gavg, cavg_prev = 0.0, gavg_prev = 0.0, freq = 0.0;
+	double cbatch[ORB_CAL_MAX_BATCHES], gbatch[ORB_CAL_MAX_BATCHES];
+	const char *source = "fixed";
+#if !defined(ORB_IS_FIXEDFREQUENCY)
+	char key[ORB_KEYSIZE];
+	int ok = 0;
+#endif
 
 #if defined(ORB_IS_FIXEDFREQUENCY)
-	ORB_ref_freq = ORB_IS_FIXEDFREQUENCY;
+	freq = ORB_IS_FIXEDFREQUENCY;
 #else
 #if defined(ORB_IS_FLOATINGPOINT)
 #   error .........................................................
@@ -60,16 +285,18 @@ void ORB_calibrate() {
 #endif /* ORB_IS_FIXEDFREQUENCY */
 	cmin = ORB_min_lat_cyc;
 	gmin = GTD_min_lat_cyc + ORB_avg_lat_cyc;
-	for (j = 0; j < 4; j++) {
-		nsam = csum = gsum = 0;	/* keep only last */
-		for (i = 0; i < 1000000; i++) {	/* sample */
+	for (j = 0; j < ORB_CAL_MAX_BATCHES; j++) {
+		cprev = cmin;
+		gprev = gmin;
+		nsam = csum = gsum = 0;
+		for (i = 0; i < ORB_CAL_BATCH; i++) {	/* sample */
 			ORB_read(t1);
 			ORB_read(t2);
 			gettimeofday(&tv1, 0);
 			ORB_read(t3);
 			c21 = ORB_cycles_u(t2, t1);
 			c32 = ORB_cycles_u(t3, t2);
-			if ((c21 >= 0) && (c32 >= 0)) {	/* GTD timers aren't monotonic */
+			if (((int64_t)c21 >= 0) && ((int64_t)c32 >= 0)) {	/* GTD timers aren't monotonic */
 				if (c21 < cmin)
 					cmin = c21;
 				if (c32 < gmin)
@@ -80,26 +307,52 @@ void ORB_calibrate() {
 			}
 		}
 		ndummy += nsam + csum + gsum;
+		if (nsam == 0)
+			continue;
+		/* batch averages of ORB() and of gtd() alone; a preempted batch
+		 * can make the difference negative, so keep it signed */
+		cavg = (double)csum / nsam;
+		gavg = (double)gsum / nsam;
+		cbatch[nb] = cavg;
+		gbatch[nb] = gavg - cavg;
+		nb++;
+		/* settled: same minimums and averages within ORB_CAL_TOL of the last batch */
+		if ((j + 1 >= ORB_CAL_MIN_BATCHES) && (cmin == cprev) && (gmin == gprev)
+		    && (cavg <= (1.0 + ORB_CAL_TOL) * cavg_prev) && (cavg >= (1.0 - ORB_CAL_TOL) * cavg_prev)
+		    && (gavg <= (1.0 + ORB_CAL_TOL) * gavg_prev) && (gavg >= (1.0 - ORB_CAL_TOL) * gavg_prev))
+			break;
+		cavg_prev = cavg;
+		gavg_prev = gavg;
+	}
+	ORB_cal_samples = (long)(j < ORB_CAL_MAX_BATCHES ? j + 1 : j) * ORB_CAL_BATCH;
+	/* the median batch, so that a preempted batch does not count; clamped at 0 */
+	if (nb > 0) {
+		cavg = ORB_median(cbatch, nb);
+		gavg = ORB_median(gbatch, nb);
+		ORB_avg_lat_cyc = (cavg > 0.0) ? (ORB_tick_t)(cavg + 0.5) : 0;
+		GTD_avg_lat_cyc = (gavg > 0.0) ? (ORB_tick_t)(gavg + 0.5) : 0;
 	}
-	Csum += csum;
-	Gsum += gsum;
-	nsamples += nsam;
-	ORB_avg_lat_cyc = (Csum + (nsamples >> 1)) / nsamples;
 	ORB_min_lat_cyc = cmin;
-	GTD_avg_lat_cyc = (Gsum - Csum + (nsamples >> 1)) / nsamples;
-	GTD_min_lat_cyc = gmin - ORB_avg_lat_cyc;
+	GTD_min_lat_cyc = (gmin > ORB_avg_lat_cyc) ? (gmin - ORB_avg_lat_cyc) : 0;
 #if !defined(ORB_IS_FIXEDFREQUENCY)	/* discover frequency */
-	gettimeofday(&tv1, 0);
-	ORB_read(t1);
-	sleep(5);		/* region = sleep()+2*ORB()+(0.5+0.5)*gtd() */
-	ORB_read(t2);
-	gettimeofday(&tv2, 0);
-	seconds = ((double)(tv2.tv_sec - tv1.tv_sec)) + ((double)(tv2.tv_usec - tv1.tv_usec)) / 1.0e+6;
-	cycles = ORB_cycles_u(t2, t1) + ORB_avg_lat_cyc + GTD_avg_lat_cyc;
-	ORB_ref_freq = ((double)(cycles)) / seconds;
+	/* reported by the hardware, cached for this CPU and kernel, or measured */
+	freq = ORB_ref_freq;
+	source = ORB_freq_source;
+	if (freq == 0.0) {
+		if ((freq = ORB_reported_freq()) > 0.0) {
+			source = "reported";
+		} else {
+			ORB_cache_key(key);
+			if ((freq = ORB_cache_read(key)) > 0.0) {
+				source = "cached";
+			} else {
+				/* ORB_cache_commit() adds it to the cache once the caller checked it too */
+				for (i = 0; (i < ORB_FREQ_TRIES) && !ok; i++)
+					freq = ORB_measure_freq(&ok);
+				source = ok ? "measured" : "unverified";
+			}
+		}
+	}
 #endif				/* ORB_IS_FIXEDFREQUENCY */
-	ORB_avg_lat_sec = ORB_avg_lat_cyc / ORB_ref_freq;
-	ORB_min_lat_sec = ORB_min_lat_cyc / ORB_ref_freq;
-	GTD_avg_lat_sec = GTD_avg_lat_cyc / ORB_ref_freq;
-	GTD_min_lat_sec = GTD_min_lat_cyc / ORB_ref_freq;
+	ORB_set_freq(freq, source);
 }
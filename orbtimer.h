@@ -45,6 +45,19 @@
  * ORB_calibrate()
  *         Initialize ORB() and estimate overheads and ref freq
  *         subsequent calls to ORB_calibrate() further refine estimates
+ *         overheads are sampled in batches until they settle and the
+ *         median batch is kept; the ref freq is taken from the hardware
+ *         (CPUID, time base) or kernel when reported, else from the cache
+ *         file ORB_cache_file (if set) for this CPU model and kernel,
+ *         else measured against gettimeofday() and checked ("unverified"
+ *         when the check fails)
+ * void
+ * ORB_set_freq(double freq, const char *source)
+ *         Replace the ref freq, e.g. by one agreed across processes
+ * void
+ * ORB_cache_commit()
+ *         Add a "measured" ref freq to ORB_cache_file; call it only once
+ *         the caller accepted the value
  * ORB_tick_t
  * ORB_cycles(ORB_t end, ORB_t start)
  * ORB_cycles_m(ORB_t end, ORB_t start)
@@ -84,10 +97,16 @@
  * (ORB_tick_t) ORB_IREFFREQ      timer ticks per second
  * (double)     ORB_REFFREQ       timer ticks per second (floating point)
  * (int)        GTD_REFFREQ       GTD timer ticks per second (integer)
+ * (char *)     ORB_cache_file    calibration cache file, NULL for none
+ * (char *)     ORB_freq_source   "fixed", "reported", "cached", "measured"
+ *                                or "unverified"
+ * (long)       ORB_cal_samples   overhead samples taken by ORB_calibrate()
+ * (int)        ORB_FREQ_PLAUSIBLE(F) whether F ticks per second can be a timer
  *************************************************************************/
 
 #ifndef HAVE_ORBTIMER
 #    define HAVE_ORBTIMER
+#    include <time.h>
 #    ifdef ORBTIMER_LIBRARY
 #        define ORBEXTERN(x,y) x=y
 #    else
@@ -95,6 +114,8 @@
 #    endif
 
 void ORB_calibrate();
+void ORB_set_freq(double freq, const char *source);
+void ORB_cache_commit();
 typedef unsigned long long ORB_tick_t;
 ORBEXTERN(int GTD_ref_freq, 1000000);
 ORBEXTERN(double ORB_ref_freq, 0.0);
@@ -107,6 +128,10 @@ ORBEXTERN(double GTD_avg_lat_sec, 0.0);
 ORBEXTERN(double GTD_min_lat_sec, 1000000.0);
 ORBEXTERN(double ORB_avg_lat_sec, 0.0);
 ORBEXTERN(double ORB_min_lat_sec, 1000000.0);
+ORBEXTERN(char *ORB_cache_file, NULL);
+ORBEXTERN(const char *ORB_freq_source, "none");
+ORBEXTERN(long ORB_cal_samples, 0);
+#    define ORB_FREQ_PLAUSIBLE(F)  ( ((F) >= 1.0e+6) && ((F) <= 1.0e+11) )
 #    define GTD_AVGLAT            ( (ORB_tick_t) (GTD_avg_lat_cyc))
 #    define GTD_AVGLATSEC         ( (double)    (GTD_avg_lat_sec) )
 #    define GTD_MINLAT            ( (ORB_tick_t) (GTD_min_lat_cyc))
@@ -168,13 +193,60 @@ typedef unsigned long long ORB_t;
                                                   "movl %%eax,%%eax \n\t" \
                                                   "salq $32,%%rdx   \n\t" \
                                                   "orq %%rdx,%%rax  \n\t" : "=a" (T) : : "%rdx")
+#            define ORB_IS_TSC
+#        else			/* HAVE_NATIVE_TIMER */
+#            error "Multiple native timers. " __FILE__ " detected previous value " HAVE_ORBTIMER_NATIVE
+#        endif			/* HAVE_ORBTIMER_NATIVE */
+#    elif defined(TIMER_X86_64_RDTSCP) || defined(TIMER_X86_64_LFENCE)
+       /**********************************************************
+        * NOTES:
+        * The same TSC as TIMER_X86_64, ordered differently.
+        * RDTSCP waits for all earlier instructions to execute
+        * (but not for earlier stores to drain, as MFENCE does)
+        * and also returns IA32_TSC_AUX, which is discarded.
+        * LFENCE;RDTSC likewise waits for earlier instructions
+        * on Intel, and on AMD when LFENCE is made dispatch
+        * serializing. Both are usually cheaper than MFENCE;RDTSC.
+        * Use '-t timer' to compare them on a given host.
+	*
+	* ORB_t		-- CPU Cycles
+	* ORB_tick_t	-- CPU Cycles
+	* ORB_REFFREQ	-- TSC Frequency
+        *********************************************************/
+#       ifndef HAVE_ORBTIMER_NATIVE
+typedef unsigned long long ORB_t;
+#            define ORB_cycles(T2,T1)     ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
+#            define ORB_cycles_m(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
+#            define ORB_cycles_a(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_avg_lat_cyc))
+#            define ORB_cycles_u(T2,T1)   ( (ORB_tick_t) (T2-T1)                )
+#            define ORB_seconds(T2,T1)    ( ((double)   (T2-T1-ORB_min_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_m(T2,T1)  ( ((double)   (T2-T1-ORB_min_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_a(T2,T1)  ( ((double)   (T2-T1-ORB_avg_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_u(T2,T1)  ( ((double)   (T2-T1)                ) / ORB_ref_freq)
+#            if defined(TIMER_X86_64_RDTSCP)
+#                define HAVE_ORBTIMER_NATIVE "X86_64_RDTSCP"
+#                define ORB_read(T)        __asm__ __volatile__ ( "  \n\t" \
+                                                      "rdtscp           \n\t" \
+                                                      "movl %%eax,%%eax \n\t" \
+                                                      "salq $32,%%rdx   \n\t" \
+                                                      "orq %%rdx,%%rax  \n\t" : "=a" (T) : : "%rdx", "%rcx")
+#            else
+#                define HAVE_ORBTIMER_NATIVE "X86_64_LFENCE"
+#                define ORB_read(T)        __asm__ __volatile__ ( "  \n\t" \
+                                                      "lfence           \n\t" \
+                                                      "rdtsc            \n\t" \
+                                                      "movl %%eax,%%eax \n\t" \
+                                                      "salq $32,%%rdx   \n\t" \
+                                                      "orq %%rdx,%%rax  \n\t" : "=a" (T) : : "%rdx")
+#            endif
+#            define ORB_IS_TSC
 #        else			/* HAVE_NATIVE_TIMER */
 #            error "Multiple native timers. " __FILE__ " detected previous value " HAVE_ORBTIMER_NATIVE
 #        endif			/* HAVE_ORBTIMER_NATIVE */
 #    elif defined(TIMER_PPC64)
 #        ifndef HAVE_ORBTIMER_NATIVE
 typedef unsigned long ORB_t;
-#            define HAVE_ORBTIMER_NATIVE
+#            define HAVE_ORBTIMER_NATIVE "PPC64"
 #            define ORB_cycles(T2,T1)     ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
 #            define ORB_cycles_m(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
 #            define ORB_cycles_a(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_avg_lat_cyc))
@@ -188,6 +260,75 @@ typedef unsigned long ORB_t;
 #        else			/* HAVE_ORBTIMER_NATIVE */
 #            error "Multiple native timers. " __FILE__ " detected previous value " HAVE_ORBTIMER_NATIVE
 #        endif			/* HAVE_ORBTIMER_NATIVE */
+#    elif defined(TIMER_AARCH64)
+       /**********************************************************
+        * NOTES:
+        * The ARMv8 generic timer's virtual count, readable from
+        * user space on Linux. Its frequency is fixed and is
+        * reported by CNTFRQ_EL0, so no calibration against
+        * gettimeofday() is needed. ISB keeps the read from
+        * being executed ahead of earlier instructions.
+	*
+	* ORB_t		-- generic timer counts
+	* ORB_tick_t	-- generic timer counts
+	* ORB_REFFREQ	-- CNTFRQ_EL0
+        *********************************************************/
+#        ifndef HAVE_ORBTIMER_NATIVE
+#            define HAVE_ORBTIMER_NATIVE "AARCH64"
+typedef unsigned long long ORB_t;
+static inline double ORB_cntfrq() {
+	unsigned long long f;
+	__asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (f));
+	return (double)f;
+}
+#            define ORB_IS_FIXEDFREQUENCY (ORB_cntfrq())
+#            define ORB_cycles(T2,T1)     ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
+#            define ORB_cycles_m(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
+#            define ORB_cycles_a(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_avg_lat_cyc))
+#            define ORB_cycles_u(T2,T1)   ( (ORB_tick_t) (T2-T1)                )
+#            define ORB_seconds(T2,T1)    ( ((double)   (T2-T1-ORB_min_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_m(T2,T1)  ( ((double)   (T2-T1-ORB_min_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_a(T2,T1)  ( ((double)   (T2-T1-ORB_avg_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_u(T2,T1)  ( ((double)   (T2-T1)                ) / ORB_ref_freq)
+#            define ORB_read(T)       __asm__ __volatile__ ( "  \n\t" \
+                                                 "isb               \n\t" \
+                                                 "mrs %0, cntvct_el0\n\t" : "=r" (T) : : "memory")
+#        else			/* HAVE_ORBTIMER_NATIVE */
+#            error "Multiple native timers. " __FILE__ " detected previous value " HAVE_ORBTIMER_NATIVE
+#        endif			/* HAVE_ORBTIMER_NATIVE */
+#    elif defined(TIMER_CLOCK_GETTIME)
+       /**********************************************************
+        * NOTES:
+        * clock_gettime(CLOCK_MONOTONIC_RAW) is portable and is
+        * not slewed by NTP. On Linux it is read through the vDSO
+        * without a system call when the kernel's clocksource
+        * allows it (tsc, arch_sys_counter); otherwise every read
+        * is a system call. Prefer a cycle counter when there is
+        * one, but this is a good default elsewhere.
+	*
+	* ORB_t		-- nanoseconds
+	* ORB_tick_t	-- nanoseconds
+	* ORB_REFFREQ	-- 1 GHz
+        *********************************************************/
+#        ifndef HAVE_ORBTIMER_NATIVE
+#            define HAVE_ORBTIMER_NATIVE "CLOCK_GETTIME"
+#            define ORB_IS_FIXEDFREQUENCY (1000000000)
+typedef unsigned long long ORB_t;
+#            define ORB_cycles(T2,T1)     ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
+#            define ORB_cycles_m(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_min_lat_cyc))
+#            define ORB_cycles_a(T2,T1)   ( (ORB_tick_t) (T2-T1-ORB_avg_lat_cyc))
+#            define ORB_cycles_u(T2,T1)   ( (ORB_tick_t) (T2-T1)                )
+#            define ORB_seconds(T2,T1)    ( ((double)   (T2-T1-ORB_min_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_m(T2,T1)  ( ((double)   (T2-T1-ORB_min_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_a(T2,T1)  ( ((double)   (T2-T1-ORB_avg_lat_cyc)) / ORB_ref_freq)
+#            define ORB_seconds_u(T2,T1)  ( ((double)   (T2-T1)                ) / ORB_ref_freq)
+#            define ORB_read(T)        do { struct timespec _orb_ts; \
+                                            clock_gettime(CLOCK_MONOTONIC_RAW, &_orb_ts); \
+                                            T = (ORB_t)_orb_ts.tv_sec * 1000000000ULL + (ORB_t)_orb_ts.tv_nsec; \
+                                       } while (0)
+#        else			/* HAVE_ORBTIMER_NATIVE */
+#            error "Multiple native timers. " __FILE__ " detected previous value " HAVE_ORBTIMER_NATIVE
+#        endif			/* HAVE_ORBTIMER_NATIVE */
 #    elif defined(TIMER_MPI_WTIME)
        /**********************************************************
         * NOTES:
@@ -250,7 +391,12 @@ typedef struct timeval ORB_t;
 #          error ....................................................................
 #          error .... No timer selected in __FILE__
 #          error .... Add one of the following to the compile:
-#          error ................ -DTIMER_X86_64 ....... uses X86-64 RDTSC instruction
+#          error ................ -DTIMER_X86_64 ....... uses X86-64 MFENCE;RDTSC instructions
+#          error ................ -DTIMER_X86_64_RDTSCP  uses X86-64 RDTSCP instruction
+#          error ................ -DTIMER_X86_64_LFENCE  uses X86-64 LFENCE;RDTSC instructions
+#          error ................ -DTIMER_PPC64 ........ uses PowerPC time base
+#          error ................ -DTIMER_AARCH64 ...... uses ARMv8 virtual counter
+#          error ................ -DTIMER_CLOCK_GETTIME  uses clock_gettime(CLOCK_MONOTONIC_RAW)
 #          error ................ -DTIMER_MPI_WTIME .... uses MPI_Wtime()
 #          error ................ -DTIMER_GTD ......... uses gettimeofday()
 #          error .... Undeclared variable complaints below are a side effect of this
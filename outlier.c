@@ -0,0 +1,234 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+/**
+ * \brief Bounded log of the slowest samples
+ *
+ * Every rank records the samples above a threshold, either fixed or the
+ * running p99.9 of its own samples, into a ring of tst->outlier_events
+ * records that keeps the most recent ones. Root_rank merges the rings
+ * into one log of the slowest tst->outlier_events events, sorted by time.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "comm.h"
+#include "measurement.h"
+#include "outlier.h"
+
+/**
+ * \brief Allocates an empty ring, collective
+ */
+outlier_p outlier_create(test_p tst) {
+	outlier_p o = (outlier_p)malloc(sizeof(outlier_t));
+	assert(o != NULL);
+	o->mem = comm_alloc_dist(OUTLIER_HDR + (size_t)tst->outlier_events * OUTLIER_WORDS);
+	o->mem[1] = tst->outlier_events;
+	o->ring = (outlier_rec_t *)(o->mem + OUTLIER_HDR);
+	o->hist = NULL;
+	o->nsamples = 0;
+	o->threshold = tst->outlier_threshold;
+	if (tst->outlier_threshold == OUTLIER_AUTO) {
+		o->hist = (uint64_t *)calloc(tst->num_bins, sizeof(uint64_t));
+		assert(o->hist != NULL);
+		o->threshold = 0.0;
+	}
+	return o;
+}
+
+/**
+ * \brief Frees a ring, collective
+ * \return NULL
+ */
+outlier_p outlier_destroy(outlier_p o) {
+	comm_free_dist(o->mem);
+	if (o->hist != NULL)
+		free(o->hist);
+	free(o);
+	return NULL;
+}
+
+/**
+ * \brief Checks a batch of samples against the threshold
+ * \param ts Start of each sample in seconds since the start of collection
+ * \param v Sample times in seconds; negative ones are invalid and skipped
+ *
+ * With the automatic threshold the batch is first added to the running
+ * distribution, so a batch is judged against the p99.9 including itself.
+ */
+void outlier_seconds(test_p tst, outlier_p o, double *ts, double *v, int n, int partner, int cycle, int stage) {
+	outlier_rec_t *r;
+	uint64_t sum, target;
+	int i, b;
+	if (o->hist != NULL) {
+		for (i = 0; i < n; i++) {
+			if (v[i] >= 0.0) {
+				o->hist[time2bin(tst, v[i])]++;
+				o->nsamples++;
+			}
+		}
+		/* upper edge of the bin holding the running p99.9 */
+		target = (uint64_t)(OUTLIER_QUANTILE * (double)o->nsamples);
+		for (b = 0, sum = 0; b < tst->num_bins - 1; b++) {
+			sum += o->hist[b];
+			if (sum > target)
+				break;
+		}
+		o->threshold = bin2time(tst, b + 1);
+	}
+	for (i = 0; i < n; i++) {
+		if ((v[i] < 0.0) || (v[i] <= o->threshold))
+			continue;
+		/* the ring keeps the newest events */
+		r = o->ring + (o->mem[0] % o->mem[1]);
+		o->mem[0]++;
+		r->time = ts[i];
+		r->value = v[i];
+		r->rank = my_rank;
+		r->partner = partner;
+		r->cycle = cycle;
+		r->stage = stage;
+	}
+}
+
+/**
+ * \brief Checks a batch of timer tick samples against the threshold
+ * \param ts Start of each sample in ticks since the start of collection
+ * \param c Sample times in ticks (invalid ones are skipped)
+ */
+void outlier_ticks(test_p tst, outlier_p o, ORB_tick_t *ts, ORB_tick_t *c, int n, int partner, int cycle, int stage) {
+	double *t, *v;
+	int i;
+	t = (double *)malloc(2 * n * sizeof(double));
+	assert(t != NULL);
+	v = t + n;
+	for (i = 0; i < n; i++) {
+		t[i] = (double)ts[i] / ORB_REFFREQ;
+		v[i] = TICK_VALID(c[i]) ? (double)c[i] / ORB_REFFREQ : -1.0;
+	}
+	outlier_seconds(tst, o, t, v, n, partner, cycle, stage);
+	free(t);
+}
+
+/**
+ * \brief Orders events by time, then rank, for qsort
+ */
+static int outlier_cmp(const void *a, const void *b) {
+	const outlier_rec_t *x = (const outlier_rec_t *)a;
+	const outlier_rec_t *y = (const outlier_rec_t *)b;
+	if (x->time != y->time)
+		return (x->time > y->time) - (x->time < y->time);
+	return (x->rank > y->rank) - (x->rank < y->rank);
+}
+
+/**
+ * \brief Restores the min-heap (by value) of n events below slot i
+ */
+static void outlier_sift(outlier_rec_t *heap, size_t n, size_t i) {
+	outlier_rec_t x = heap[i];
+	size_t c;
+	while ((c = 2 * i + 1) < n) {
+		if ((c + 1 < n) && (heap[c + 1].value < heap[c].value))
+			c++;
+		if (heap[c].value >= x.value)
+			break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = x;
+}
+
+/**
+ * \brief Merges the rings of all ranks into one log on root_rank, collective
+ * \param m Local measurement holding this rank's ring (m->outliers)
+ * \param label Names the log: <case_name>/<label>.OUTLIERS.<root_rank>
+ *
+ * Root fetches one ring at a time and keeps the slowest
+ * tst->outlier_events events of all rings in a heap, so it holds at
+ * most two rings' worth of records however many ranks there are.
+ * Times are per rank, counted from that rank's start of collection;
+ * ranks start together after a barrier.
+ */
+void outlier_write(test_p tst, measurement_p m, char *label) {
+	outlier_p o = m->outliers;
+	outlier_rec_t *heap = NULL, *ring;
+	uint64_t *row = NULL, seen = 0, logged = 0;
+	size_t len, n = 0, i, k, kept;
+	int r;
+
+	if (o == NULL)
+		return;
+	len = OUTLIER_HDR + (size_t)tst->outlier_events * OUTLIER_WORDS;
+	ROOTONLY {
+		row = (uint64_t *)malloc(len * sizeof(uint64_t));
+		heap = (outlier_rec_t *)malloc((size_t)tst->outlier_events * sizeof(outlier_rec_t));
+		assert((row != NULL) && (heap != NULL));
+	}
+	comm_barrier();
+	for (r = 0; r < num_ranks; r++) {
+		comm_fetch_row(row, o->mem, len, r);
+		ROOTONLY {
+			ring = (outlier_rec_t *)(row + OUTLIER_HDR);
+			kept = (row[0] < row[1]) ? row[0] : row[1];
+			for (k = 0; k < kept; k++) {
+				if (n < (size_t)tst->outlier_events) {
+					heap[n++] = ring[k];
+					if (n == (size_t)tst->outlier_events)
+						for (i = n / 2; i-- > 0; )
+							outlier_sift(heap, n, i);
+				} else if (ring[k].value > heap[0].value) {
+					heap[0] = ring[k];
+					outlier_sift(heap, n, 0);
+				}
+			}
+			seen += row[0];
+			logged += kept;
+		}
+	}
+	comm_barrier();
+
+	ROOTONLY {
+		char fname[FNAMESIZE];
+		FILE *Fout;
+		qsort(heap, n, sizeof(outlier_rec_t), outlier_cmp);
+		snprintf(fname, FNAMESIZE, "%s/%s.OUTLIERS.%d", tst->case_name, label, my_rank);
+		Fout = fopen(fname, "w");
+		assert(Fout != NULL);
+		measurement_print_header(Fout, tst, label, NULL);
+		if (tst->outlier_threshold == OUTLIER_AUTO)
+			fprintf(Fout, "# Outliers:          samples above each rank's running p%g\n", OUTLIER_QUANTILE * 100.0);
+		else
+			fprintf(Fout, "# Outliers:          samples above %g usec\n", tst->outlier_threshold * 1.0e+6);
+		fprintf(Fout, "# Events:            %"PRIu64" seen, %"PRIu64" in the rings (the newest %d per rank), "
+			"%zu kept (the slowest %d of them)\n", seen, logged, tst->outlier_events, n, tst->outlier_events);
+		fprintf(Fout, "#%15s %8s %8s %8s %8s %15s\n", "time(s)", "rank", "partner", "cycle", "stage", "value(us)");
+		for (k = 0; k < n; k++)
+			fprintf(Fout, "%16.9f %8d %8d %8d %8d %15.4f\n", heap[k].time, heap[k].rank,
+				heap[k].partner, heap[k].cycle, heap[k].stage, heap[k].value * 1.0e+6);
+		fclose(Fout);
+		free(heap);
+		free(row);
+	}
+}
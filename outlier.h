@@ -0,0 +1,71 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+#ifndef HAVE_OUTLIER_H
+#define HAVE_OUTLIER_H
+
+#include "types.h"
+#include "config.h"
+#include "orbtimer.h"
+
+/* tst->outlier_threshold asking for the running p99.9 */
+#define OUTLIER_AUTO (-1.0)
+/* quantile of the running threshold */
+#define OUTLIER_QUANTILE 0.999
+/* default ring size in events */
+#define OUTLIER_EVENTS 1024
+
+/* one slow sample */
+typedef struct outlier_rec {
+	double time;		/* seconds since the start of collection */
+	double value;		/* sample time in seconds */
+	int32_t rank;		/* rank that took the sample */
+	int32_t partner;	/* partner rank (-1 if none) */
+	int32_t cycle;		/* cycle */
+	int32_t stage;		/* stage (or operation) */
+} outlier_rec_t;
+
+/* words of the ring header: events seen and ring size */
+#define OUTLIER_HDR 2
+/* words per event */
+#define OUTLIER_WORDS (sizeof(outlier_rec_t) / sizeof(uint64_t))
+
+/* per-rank ring of the most recent outliers */
+typedef struct outlier {
+	uint64_t *mem;		/* header and ring, symmetric (comm_alloc_dist) */
+	outlier_rec_t *ring;	/* tst->outlier_events records after the header */
+	double threshold;	/* current threshold in seconds */
+	uint64_t *hist;		/* running distribution for the automatic threshold */
+	uint64_t nsamples;	/* samples in hist */
+} outlier_t;
+typedef outlier_t* outlier_p;
+
+/**************************************************************
+ * FUNCTION PROTOTYPES
+ **************************************************************/
+outlier_p outlier_create(test_p tst);
+outlier_p outlier_destroy(outlier_p o);
+void outlier_seconds(test_p tst, outlier_p o, double *ts, double *v, int n, int partner, int cycle, int stage);
+void outlier_ticks(test_p tst, outlier_p o, ORB_tick_t *ts, ORB_tick_t *c, int n, int partner, int cycle, int stage);
+void outlier_write(test_p tst, measurement_p m, char *label);
+
+#endif				/* HAVE_OUTLIER_H */
@@ -0,0 +1,553 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+/**
+ * \brief Per-partner latency summaries of the net test
+ *
+ * Each rank keeps one summary per partner (sample count, minimum,
+ * median and p99 estimates, maximum) of the pairwise timings. Root_rank
+ * streams the rows into an N x N matrix file, and the suspects report
+ * ranks the pairs, ranks and nodes that are slow against the fleet.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "types.h"
+#include "comm.h"
+#include "measurement.h"
+#include "pairs.h"
+
+/**
+ * \brief Orders timer ticks for qsort
+ */
+static int pairs_cmp(const void *a, const void *b) {
+	ORB_tick_t x = *(const ORB_tick_t *)a;
+	ORB_tick_t y = *(const ORB_tick_t *)b;
+	return (x > y) - (x < y);
+}
+
+/* log-linear binning of the per-partner histograms, for tick2bin() and bin2tick() */
+static test_t pairs_bins;
+
+/**
+ * \brief Allocates the (zeroed) summaries of all partners of this rank
+ * \return num_ranks * PAIR_FIELDS words, followed by the num_ranks
+ * histograms of PAIR_BINS counts; collective and symmetric for SHMEM
+ */
+uint64_t *pairs_create(test_p tst) {
+	pairs_bins.log_binning = BIN_LOGLINEAR;
+	pairs_bins.subbucket_bits = PAIR_SUBBUCKET_BITS;
+	pairs_bins.num_bins = PAIR_BINS;
+	return comm_alloc_dist((size_t)num_ranks * (PAIR_FIELDS + PAIR_BINS / 2));
+}
+
+/**
+ * \brief The i-th smallest (from 0) of the n samples in a histogram
+ *
+ * Interpolates within the bin, and stays within the exact min and max.
+ */
+static uint64_t pairs_quantile(uint32_t *h, uint64_t i, uint64_t *p) {
+	uint64_t below = 0, lo, hi, q;
+	int b;
+	for (b = 0; (b < PAIR_BINS - 1) && (below + h[b] <= i); b++)
+		below += h[b];
+	lo = bin2tick(&pairs_bins, b);
+	hi = (b < PAIR_BINS - 1) ? bin2tick(&pairs_bins, b + 1) : p[PAIR_MAX];
+	q = lo + (uint64_t)(((double)(i - below) + 0.5) / h[b] * (double)(hi - lo));
+	if (q < p[PAIR_MIN])
+		q = p[PAIR_MIN];
+	if (q > p[PAIR_MAX])
+		q = p[PAIR_MAX];
+	return q;
+}
+
+/**
+ * \brief Folds one visit to a partner into its summary
+ * \param pairs Summaries from pairs_create()
+ * \param partner Rank of the partner
+ * \param c Timings (ticks) of the visit, or of a chunk of it; invalid ones are skipped
+ * \param nc Number of timings
+ *
+ * The count, min and max are exact. The median and p99 are read from
+ * the partner's histogram over all its samples, so they are within a
+ * bin (12.5%) of the exact ones.
+ */
+void pairs_add(test_p tst, uint64_t *pairs, int partner, ORB_tick_t *c, int nc) {
+	uint64_t *p = pairs + (size_t)partner * PAIR_FIELDS;
+	uint32_t *h = (uint32_t *)(pairs + (size_t)num_ranks * PAIR_FIELDS) + (size_t)partner * PAIR_BINS;
+	uint64_t n;
+	int i;
+
+	n = p[PAIR_COUNT];
+	for (i = 0; i < nc; i++) {
+		if (!TICK_VALID(c[i]))
+			continue;
+		if ((n == 0) || (c[i] < p[PAIR_MIN]))
+			p[PAIR_MIN] = c[i];
+		if ((n == 0) || (c[i] > p[PAIR_MAX]))
+			p[PAIR_MAX] = c[i];
+		h[tick2bin(&pairs_bins, c[i])]++;
+		n++;
+	}
+	if (n > p[PAIR_COUNT]) {
+		p[PAIR_COUNT] = n;
+		p[PAIR_MED] = pairs_quantile(h, n / 2, p);
+		p[PAIR_P99] = pairs_quantile(h, (n * 99) / 100, p);
+	}
+}
+
+/**
+ * \brief Writes one per-pair matrix, collective
+ * \param pairs This rank's summaries
+ * \param kind Names the file with label: <case_name>/<label>.<kind>.<root_rank>
+ */
+static void pairs_write_matrix(test_p tst, measurement_p m, uint64_t *pairs, char *label, char *kind) {
+	char fname[FNAMESIZE], magic[8];
+	uint64_t *row = NULL, hdr[3], *p;
+	double freq, scale;
+	size_t count;
+	FILE *Fpairs = NULL;
+	int r, j, k;
+
+	count = (size_t)num_ranks * PAIR_FIELDS;
+	ROOTONLY {
+		row = (uint64_t *)malloc(count * sizeof(uint64_t));
+		assert(row != NULL);
+		snprintf(fname, FNAMESIZE, "%s/%s.%s.%d", tst->case_name, label, kind, my_rank);
+		Fpairs = fopen(fname, "wb");
+		assert(Fpairs != NULL);
+		memset(magic, 0, sizeof(magic));
+		strncpy(magic, PAIRS_MAGIC, sizeof(magic));
+		hdr[0] = num_ranks;
+		hdr[1] = PAIR_FIELDS;
+		hdr[2] = m->buflen;
+		freq = ORB_REFFREQ;
+		fwrite(magic, sizeof(magic), 1, Fpairs);
+		fwrite(hdr, sizeof(uint64_t), 3, Fpairs);
+		fwrite(&freq, sizeof(double), 1, Fpairs);
+	}
+	comm_barrier();
+	for (r = 0; r < num_ranks; r++) {
+		comm_fetch_row(row, pairs, count, r);
+		ROOTONLY {
+			/* from rank r's ticks to root's */
+			scale = (rank_freq[r] > 0.0) ? freq / rank_freq[r] : 1.0;
+			if (scale != 1.0) {
+				for (j = 0; j < num_ranks; j++) {
+					p = row + (size_t)j * PAIR_FIELDS;
+					for (k = PAIR_MIN; k <= PAIR_MAX; k++)
+						p[k] = (uint64_t)((double)p[k] * scale + 0.5);
+				}
+			}
+			fwrite(row, sizeof(uint64_t), count, Fpairs);
+		}
+	}
+	comm_barrier();
+	ROOTONLY {
+		fclose(Fpairs);
+		free(row);
+	}
+}
+
+/**
+ * \brief Writes the per-pair matrices of a measurement, collective
+ * \param m Local measurement holding this rank's summaries (m->pairs, m->oneway)
+ * \param label Names the files: <case_name>/<label>.PAIRS.<root_rank>,
+ * and <case_name>/<label>.ONEWAY.<root_rank> with one-way latencies (-s)
+ *
+ * The file holds a header
+ *
+ *     char magic[8]; uint64_t num_ranks, fields, buflen; double ticks_per_second;
+ *
+ * followed by num_ranks rows of num_ranks summaries of PAIR_FIELDS
+ * uint64_t each (count, min, median, p99, max), in native byte order.
+ * Each rank times in its own ticks; root converts every row to its own,
+ * so all times are in ticks_per_second.
+ * Row i column j is measured by rank i with partner j; a zero count
+ * means the pair was never visited. Root holds one row at a time.
+ * In the ONEWAY file row i column j is the one-way latency from
+ * partner j to rank i, so column j of row i and column i of row j are
+ * the two directions of a pair.
+ */
+void pairs_write(test_p tst, measurement_p m, char *label) {
+	if ((m->pairs == NULL) || !tst->pair_matrix)
+		return;
+	pairs_write_matrix(tst, m, m->pairs, label, "PAIRS");
+	if (m->oneway != NULL)
+		pairs_write_matrix(tst, m, m->oneway, label, "ONEWAY");
+}
+
+/* scales a median absolute deviation to a normal standard deviation */
+#define MAD_SCALE 1.4826
+/* deviations below this fraction of the median are never significant */
+#define MIN_DEVIATION 0.01
+
+/* per-rank row sent to root: the rank's own statistics, then its suspect pairs */
+enum {ROW_MED=0, ROW_P99=1, ROW_NSUSPECTS=2, ROW_SUSPECTS=3};
+#define ROW_LEN (ROW_SUSPECTS + 3 * PAIRS_SUSPECTS)
+
+/* a flagged pair, rank or node */
+typedef struct suspect {
+	double score;		/* robust deviations above the fleet */
+	uint64_t a, b;		/* ranks of a pair, or the rank or node id */
+	double med, p99;	/* its median and p99, in seconds on root (a rank's own ticks before) */
+} suspect_t;
+
+/**
+ * \brief Orders suspects by decreasing score for qsort
+ */
+static int pairs_scorecmp(const void *a, const void *b) {
+	double x = ((const suspect_t *)a)->score;
+	double y = ((const suspect_t *)b)->score;
+	return (x < y) - (x > y);
+}
+
+/**
+ * \brief Orders doubles for qsort
+ */
+static int pairs_dblcmp(const void *a, const void *b) {
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * \brief Orders ranks by node id for qsort
+ */
+static int pairs_nodecmp(const void *a, const void *b) {
+	uint64_t x = node_id[*(const int *)a];
+	uint64_t y = node_id[*(const int *)b];
+	return (x > y) - (x < y);
+}
+
+/**
+ * \brief Robust center and deviation scale of n values
+ * \param v The values, sorted and overwritten
+ * \param center Median
+ * \param scale MAD scaled to a standard deviation, at least MIN_DEVIATION * median
+ */
+static void pairs_robust(double *v, int n, double *center, double *scale) {
+	int i;
+	*center = *scale = 0.0;
+	if (n == 0)
+		return;
+	qsort(v, n, sizeof(double), pairs_dblcmp);
+	*center = v[n / 2];
+	for (i = 0; i < n; i++)
+		v[i] = fabs(v[i] - *center);
+	qsort(v, n, sizeof(double), pairs_dblcmp);
+	*scale = MAD_SCALE * v[n / 2];
+	if (*scale < MIN_DEVIATION * *center)
+		*scale = MIN_DEVIATION * *center;
+}
+
+/**
+ * \brief Bin of a time in seconds, on root's timebase
+ * \param rfreq Root's timer frequency
+ *
+ * Only log-linear bins are in ticks (and would take this rank's frequency
+ * in time2bin()); the other binnings are in seconds already.
+ */
+static int pairs_secbin(test_p tst, double sec, double rfreq) {
+	if (tst->log_binning == BIN_LOGLINEAR)
+		return tick2bin(tst, (ORB_tick_t)(sec * rfreq));
+	return time2bin(tst, sec);
+}
+
+/**
+ * \brief How far a median and p99 lie above the fleet, in robust deviations
+ */
+static double pairs_score(double med, double p99, double *center, double *scale) {
+	double smed = (med - center[0]) / NODIVIDEBYZERO(scale[0]);
+	double sp99 = (p99 - center[1]) / NODIVIDEBYZERO(scale[1]);
+	return (smed > sp99) ? smed : sp99;
+}
+
+/**
+ * \brief Writes the flagged entries of one kind to the report
+ */
+static void pairs_print(FILE *f, char *kind, suspect_t *s, int n) {
+	int i;
+	qsort(s, n, sizeof(suspect_t), pairs_scorecmp);
+	for (i = 0; i < n; i++) {
+		fprintf(f, "%-5s %10"PRIu64" %10"PRIu64" %12.4g %12.4g %10.2f\n", kind, s[i].a, s[i].b,
+			s[i].med * 1.0e+6, s[i].p99 * 1.0e+6, s[i].score);
+	}
+	if (n == 0)
+		fprintf(f, "# no %s suspects\n", kind);
+}
+
+/**
+ * \brief Flags pairs, ranks and nodes that are slow against the fleet, collective
+ * \param m Local measurement holding this rank's summaries (m->pairs)
+ * \param label Names the report: <case_name>/<label>.SUSPECTS.<root_rank>
+ *
+ * A pair, rank or node is a suspect when its median or p99 lies more than
+ * tst->suspect_k robust deviations (scaled median absolute deviation)
+ * above the median of its population. All statistics are in seconds,
+ * each rank converting its ticks with its own timer frequency; ranks
+ * whose frequency is implausible are left out and listed in the report.
+ * The fleet statistics of the pairs come from histograms aggregated like
+ * the measurements, binned on root's timebase, so no rank holds all
+ * pairs; a rank's statistics are the medians over its partners, and a
+ * node's are the medians over its ranks. Each rank sends root its
+ * PAIRS_SUSPECTS worst pairs.
+ */
+void pairs_suspects(test_p tst, measurement_p m, char *label) {
+	measurement_p l, g;
+	ORB_tick_t *v;
+	uint64_t *p, *row, *rows = NULL;
+	double center[2], scale[2], rcenter[2], rscale[2], *freq, rfreq, sec[2];
+	suspect_t worst[PAIRS_SUSPECTS];
+	int i, j, k, n, nworst = 0, valid;
+
+	if ((tst->suspect_k <= 0.0) || (m->pairs == NULL))
+		return;
+
+	/* every rank's timer frequency, and root's as the common timebase of the histograms */
+	freq = rank_freq;
+	valid = ORB_FREQ_PLAUSIBLE(freq[my_rank]);
+	rfreq = freq[root_rank];
+
+	/* fleet medians of the pair medians and p99s (each pair is seen from both ends) */
+	l = measurement_real_create(tst, "pairs", 2);
+	g = measurement_real_create(tst, "pairs", 2);
+	for (j = 0; valid && (j < num_ranks); j++) {
+		p = m->pairs + (size_t)j * PAIR_FIELDS;
+		if (p[PAIR_COUNT] == 0)
+			continue;
+		for (k = 0; k < 2; k++) {
+			sec[k] = (double)p[PAIR_MED + k] / freq[my_rank];
+			MEASUREMENT_BIN(l, k, pairs_secbin(tst, sec[k], rfreq))++;
+		}
+	}
+	comm_aggregate(tst, g, l);
+	ROOTONLY {
+		for (k = 0; k < 2; k++) {
+			measurement_histogram(tst, &(g->hist[k]), -1.0);
+			center[k] = g->hist[k].med0;
+		}
+	}
+	comm_broadcast_double(center, 2);
+
+	/* and the medians of their absolute deviations */
+	memset(l->dist, 0, l->dist_len * sizeof(uint64_t));
+	for (j = 0; valid && (j < num_ranks); j++) {
+		p = m->pairs + (size_t)j * PAIR_FIELDS;
+		if (p[PAIR_COUNT] == 0)
+			continue;
+		for (k = 0; k < 2; k++) {
+			sec[k] = fabs((double)p[PAIR_MED + k] / freq[my_rank] - center[k]);
+			MEASUREMENT_BIN(l, k, pairs_secbin(tst, sec[k], rfreq))++;
+		}
+	}
+	comm_aggregate(tst, g, l);
+	ROOTONLY {
+		for (k = 0; k < 2; k++) {
+			measurement_histogram(tst, &(g->hist[k]), -1.0);
+			scale[k] = MAD_SCALE * g->hist[k].med0;
+			if (scale[k] < MIN_DEVIATION * center[k])
+				scale[k] = MIN_DEVIATION * center[k];
+		}
+	}
+	comm_broadcast_double(scale, 2);
+	l = measurement_destroy(l);
+	g = measurement_destroy(g);
+
+	/* this rank's statistics over its partners, and its worst pairs (each pair once) */
+	row = comm_alloc_dist(ROW_LEN);
+	v = (ORB_tick_t *)malloc(2 * num_ranks * sizeof(ORB_tick_t));
+	assert(v != NULL);
+	n = 0;
+	for (j = 0; valid && (j < num_ranks); j++) {
+		p = m->pairs + (size_t)j * PAIR_FIELDS;
+		if (p[PAIR_COUNT] == 0)
+			continue;
+		v[n] = p[PAIR_MED];
+		v[num_ranks + n] = p[PAIR_P99];
+		n++;
+		double score = pairs_score((double)p[PAIR_MED] / freq[my_rank], (double)p[PAIR_P99] / freq[my_rank],
+					   center, scale);
+		if ((j < my_rank) || (score <= tst->suspect_k))
+			continue;
+		/* keep the PAIRS_SUSPECTS highest scores */
+		k = nworst;
+		if (nworst == PAIRS_SUSPECTS) {
+			for (k = 0, i = 1; i < nworst; i++)
+				if (worst[i].score < worst[k].score)
+					k = i;
+			if (worst[k].score >= score)
+				continue;
+		} else {
+			nworst++;
+		}
+		worst[k].score = score;
+		worst[k].b = j;
+		worst[k].med = p[PAIR_MED];
+		worst[k].p99 = p[PAIR_P99];
+	}
+	row[ROW_MED] = row[ROW_P99] = 0;
+	if (n > 0) {
+		qsort(v, n, sizeof(ORB_tick_t), pairs_cmp);
+		qsort(v + num_ranks, n, sizeof(ORB_tick_t), pairs_cmp);
+		row[ROW_MED] = v[n / 2];
+		row[ROW_P99] = v[num_ranks + n / 2];
+	}
+	row[ROW_NSUSPECTS] = nworst;
+	for (k = 0; k < nworst; k++) {
+		row[ROW_SUSPECTS + 3 * k] = worst[k].b;
+		row[ROW_SUSPECTS + 3 * k + 1] = (uint64_t)worst[k].med;
+		row[ROW_SUSPECTS + 3 * k + 2] = (uint64_t)worst[k].p99;
+	}
+	free(v);
+
+	/* root collects the rows, still in each rank's ticks */
+	ROOTONLY {
+		rows = (uint64_t *)malloc((size_t)num_ranks * ROW_LEN * sizeof(uint64_t));
+		assert(rows != NULL);
+	}
+	comm_barrier();
+	for (i = 0; i < num_ranks; i++)
+		comm_fetch_row((rows == NULL) ? NULL : rows + (size_t)i * ROW_LEN, row, ROW_LEN, i);
+	comm_barrier();
+	comm_free_dist(row);
+
+	ROOTONLY {
+		char fname[FNAMESIZE];
+		FILE *Fsus;
+		suspect_t *sp, *sr, *sn;
+		int np = 0, nr = 0, nn = 0, nv = 0, nbad = 0, *order;
+		double *w;
+		uint64_t *r;
+
+		sp = (suspect_t *)malloc((size_t)num_ranks * PAIRS_SUSPECTS * sizeof(suspect_t));
+		sr = (suspect_t *)malloc((size_t)num_ranks * sizeof(suspect_t));
+		sn = (suspect_t *)malloc((size_t)num_ranks * sizeof(suspect_t));
+		w = (double *)malloc(2 * num_ranks * sizeof(double));
+		order = (int *)malloc(num_ranks * sizeof(int));
+		assert(sp && sr && sn && w && order);
+
+		/* pairs */
+		for (i = 0; i < num_ranks; i++) {
+			r = rows + (size_t)i * ROW_LEN;
+			for (k = 0; k < (int)r[ROW_NSUSPECTS]; k++, np++) {
+				sp[np].a = i;
+				sp[np].b = r[ROW_SUSPECTS + 3 * k];
+				sp[np].med = (double)r[ROW_SUSPECTS + 3 * k + 1] / freq[i];
+				sp[np].p99 = (double)r[ROW_SUSPECTS + 3 * k + 2] / freq[i];
+				sp[np].score = pairs_score(sp[np].med, sp[np].p99, center, scale);
+			}
+		}
+
+		/* ranks with a plausible timer */
+		for (i = 0; i < num_ranks; i++) {
+			if (!ORB_FREQ_PLAUSIBLE(freq[i])) {
+				nbad++;
+				continue;
+			}
+			w[nv] = rows[(size_t)i * ROW_LEN + ROW_MED] / freq[i];
+			w[num_ranks + nv] = rows[(size_t)i * ROW_LEN + ROW_P99] / freq[i];
+			nv++;
+		}
+		pairs_robust(w, nv, &rcenter[0], &rscale[0]);
+		pairs_robust(w + num_ranks, nv, &rcenter[1], &rscale[1]);
+		for (i = 0; i < num_ranks; i++) {
+			if (!ORB_FREQ_PLAUSIBLE(freq[i]))
+				continue;
+			r = rows + (size_t)i * ROW_LEN;
+			sr[nr].med = r[ROW_MED] / freq[i];
+			sr[nr].p99 = r[ROW_P99] / freq[i];
+			sr[nr].score = pairs_score(sr[nr].med, sr[nr].p99, rcenter, rscale);
+			if (sr[nr].score <= tst->suspect_k)
+				continue;
+			sr[nr].a = i;
+			sr[nr].b = node_id[i];
+			nr++;
+		}
+
+		/* nodes: medians over their ranks, ranks ordered by node */
+		for (i = 0; i < num_ranks; i++)
+			order[i] = i;
+		qsort(order, num_ranks, sizeof(int), pairs_nodecmp);
+		n = 0;
+		for (i = 0; i < num_ranks; i = j) {
+			nv = 0;
+			for (j = i; (j < num_ranks) && (node_id[order[j]] == node_id[order[i]]); j++) {
+				if (!ORB_FREQ_PLAUSIBLE(freq[order[j]]))
+					continue;
+				w[nv] = rows[(size_t)order[j] * ROW_LEN + ROW_MED] / freq[order[j]];
+				w[num_ranks + nv] = rows[(size_t)order[j] * ROW_LEN + ROW_P99] / freq[order[j]];
+				nv++;
+			}
+			if (nv == 0)
+				continue;
+			qsort(w, nv, sizeof(double), pairs_dblcmp);
+			qsort(w + num_ranks, nv, sizeof(double), pairs_dblcmp);
+			sn[n].a = node_id[order[i]];
+			sn[n].b = nv;
+			sn[n].med = w[nv / 2];
+			sn[n].p99 = w[num_ranks + nv / 2];
+			n++;
+		}
+		for (i = 0; i < n; i++) {
+			w[i] = sn[i].med;
+			w[num_ranks + i] = sn[i].p99;
+		}
+		pairs_robust(w, n, &rcenter[0], &rscale[0]);
+		pairs_robust(w + num_ranks, n, &rcenter[1], &rscale[1]);
+		for (i = 0; i < n; i++) {
+			sn[i].score = pairs_score(sn[i].med, sn[i].p99, rcenter, rscale);
+			if (sn[i].score > tst->suspect_k)
+				sn[nn++] = sn[i];
+		}
+
+		snprintf(fname, FNAMESIZE, "%s/%s.SUSPECTS.%d", tst->case_name, label, my_rank);
+		Fsus = fopen(fname, "w");
+		assert(Fsus != NULL);
+		measurement_print_header(Fsus, tst, label, NULL);
+		fprintf(Fsus, "# Suspects:          median or p99 more than %g robust deviations above the fleet\n", tst->suspect_k);
+		fprintf(Fsus, "# Pair Fleet:        median %.4g usec (deviation %.3g), p99 %.4g usec (deviation %.3g)\n",
+			center[0] * 1.0e+6, scale[0] * 1.0e+6, center[1] * 1.0e+6, scale[1] * 1.0e+6);
+		for (i = 0; i < num_ranks; i++)
+			if (!ORB_FREQ_PLAUSIBLE(freq[i]))
+				fprintf(Fsus, "# Excluded:          rank %d, implausible timer frequency %.10g Hz\n", i, freq[i]);
+		fprintf(Fsus, "# pair: rank rank, rank: rank node, node: node ranks; worst first\n");
+		fprintf(Fsus, "#%-4s %10s %10s %12s %12s %10s\n", "kind", "id", "id", "median(us)", "p99(us)", "score");
+		pairs_print(Fsus, "node", sn, nn);
+		pairs_print(Fsus, "rank", sr, nr);
+		pairs_print(Fsus, "pair", sp, np);
+		fclose(Fsus);
+		printf("Confidence: %d suspect node(s), %d rank(s), %d pair(s)\n", nn, nr, np);
+		if (nbad > 0)
+			printf("Confidence: %d rank(s) with an implausible timer frequency left out of the suspects\n", nbad);
+
+		free(order);
+		free(w);
+		free(sn);
+		free(sr);
+		free(sp);
+		free(rows);
+	}
+}
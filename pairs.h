@@ -0,0 +1,53 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+#ifndef HAVE_PAIRS_H
+#define HAVE_PAIRS_H
+
+#include "types.h"
+#include "config.h"
+#include "orbtimer.h"
+
+/* fields of a per-partner summary, all but the count in timer ticks */
+enum {PAIR_COUNT=0, PAIR_MIN=1, PAIR_MED=2, PAIR_P99=3, PAIR_MAX=4, PAIR_FIELDS=5};
+
+/* per-partner histogram behind the median and p99: log-linear with
+ * 2^PAIR_SUBBUCKET_BITS bins per octave of ticks (within 12.5%),
+ * PAIR_BINS 32-bit counts reaching past 2^40 ticks */
+#define PAIR_SUBBUCKET_BITS 3
+#define PAIR_BINS 320
+
+/* most suspect pairs each rank reports to root */
+#define PAIRS_SUSPECTS 16
+
+/* first bytes of a PAIRS file */
+#define PAIRS_MAGIC "SCPAIRS"
+
+/**************************************************************
+ * FUNCTION PROTOTYPES
+ **************************************************************/
+uint64_t *pairs_create(test_p tst);
+void pairs_add(test_p tst, uint64_t *pairs, int partner, ORB_tick_t *c, int nc);
+void pairs_write(test_p tst, measurement_p m, char *label);
+void pairs_suspects(test_p tst, measurement_p m, char *label);
+
+#endif				/* HAVE_PAIRS_H */
@@ -0,0 +1,243 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+/**
+ * \brief CPU affinity and on-node placement classes between ranks
+ *
+ * With a pinning policy each rank binds itself to one of the CPUs the
+ * launcher allowed it, numbered by its index among the ranks of its node:
+ * 'compact' fills the CPUs in order, 'scatter' round-robins the sockets.
+ * Policy 'none' keeps the launcher's binding. Either way every rank then
+ * reads the socket, L3 cache and NUMA node of the CPU it runs on from
+ * sysfs, and all ranks gather them to classify on-node pairs.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <dirent.h>
+
+#include "types.h"
+#include "comm.h"
+#include "placement.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+/* most cache indices looked at for the L3 */
+#define PLACE_CACHE_INDICES 16
+
+/**
+ * \brief Reads the leading number of a sysfs file of a CPU
+ * \param fmt Path below the CPU's directory, may hold one %d
+ * \return The number, or -1 if the file can not be read
+ */
+static long placement_sysfs(int cpu, const char *fmt, int arg) {
+	char path[NAMEBUFFSIZE], rel[LABEL_LEN];
+	long v = -1;
+	FILE *f;
+	snprintf(rel, LABEL_LEN, fmt, arg);
+	snprintf(path, NAMEBUFFSIZE, SYSFS_CPU "/cpu%d/%s", cpu, rel);
+	f = fopen(path, "r");
+	if (f == NULL)
+		return -1;
+	if (fscanf(f, "%ld", &v) != 1)
+		v = -1;
+	fclose(f);
+	return v;
+}
+
+/**
+ * \brief Socket of a CPU
+ */
+static uint64_t placement_socket(int cpu) {
+	long v = placement_sysfs(cpu, "topology/physical_package_id", 0);
+	return (v < 0) ? PLACE_NONE : (uint64_t)v;
+}
+
+/**
+ * \brief L3 cache of a CPU, by its id or else by the first CPU sharing it
+ */
+static uint64_t placement_l3(int cpu) {
+	long v;
+	int i;
+	for (i = 0; i < PLACE_CACHE_INDICES; i++) {
+		if (placement_sysfs(cpu, "cache/index%d/level", i) != 3)
+			continue;
+		v = placement_sysfs(cpu, "cache/index%d/id", i);
+		if (v < 0)
+			v = placement_sysfs(cpu, "cache/index%d/shared_cpu_list", i);
+		return (v < 0) ? PLACE_NONE : (uint64_t)v;
+	}
+	return PLACE_NONE;
+}
+
+/**
+ * \brief NUMA node of a CPU, from the node<n> link in its directory
+ */
+static uint64_t placement_numa(int cpu) {
+	char path[NAMEBUFFSIZE];
+	struct dirent *e;
+	uint64_t v = PLACE_NONE;
+	DIR *d;
+	snprintf(path, NAMEBUFFSIZE, SYSFS_CPU "/cpu%d", cpu);
+	d = opendir(path);
+	if (d == NULL)
+		return PLACE_NONE;
+	while ((e = readdir(d)) != NULL) {
+		if ((strncmp(e->d_name, "node", 4) == 0) && (e->d_name[4] >= '0') && (e->d_name[4] <= '9')) {
+			v = strtoull(e->d_name + 4, NULL, 10);
+			break;
+		}
+	}
+	closedir(d);
+	return v;
+}
+
+/**
+ * \brief Binds this rank to one CPU of its affinity mask per tst->pin_policy
+ * \return 0, or 1 if the binding failed
+ */
+static int placement_pin(test_p tst) {
+	cpu_set_t mask;
+	int *cpus, *order, *nth, ncpu = 0, local = 0, i, j, k, cpu;
+	uint64_t *sock;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask) != 0)
+		return 1;
+	cpus = (int *)malloc(CPU_SETSIZE * sizeof(int));
+	order = (int *)malloc(CPU_SETSIZE * sizeof(int));
+	nth = (int *)malloc(CPU_SETSIZE * sizeof(int));		/* index of each CPU within its socket */
+	sock = (uint64_t *)malloc(CPU_SETSIZE * sizeof(uint64_t));
+	assert((cpus != NULL) && (order != NULL) && (nth != NULL) && (sock != NULL));
+	for (i = 0; i < CPU_SETSIZE; i++)
+		if (CPU_ISSET(i, &mask))
+			cpus[ncpu++] = i;
+	/* this rank's index among the ranks of its node */
+	for (i = 0; i < my_rank; i++)
+		if (node_id[i] == node_id[my_rank])
+			local++;
+
+	if (tst->pin_policy == PIN_SCATTER) {
+		/* the first CPU of each socket, then the second of each, ... */
+		for (i = 0; i < ncpu; i++) {
+			sock[i] = placement_socket(cpus[i]);
+			for (nth[i] = 0, j = 0; j < i; j++)
+				if (sock[j] == sock[i])
+					nth[i]++;
+		}
+		for (k = 0, j = 0; k < ncpu; j++)
+			for (i = 0; i < ncpu; i++)
+				if (nth[i] == j)
+					order[k++] = i;
+		cpu = cpus[order[local % ncpu]];
+	} else {
+		cpu = cpus[local % ncpu];
+	}
+	free(sock);
+	free(nth);
+	free(order);
+	free(cpus);
+
+	CPU_ZERO(&mask);
+	CPU_SET(cpu, &mask);
+	return (sched_setaffinity(0, sizeof(mask), &mask) != 0);
+}
+
+/**
+ * \brief Pins this rank per tst->pin_policy, then gives every rank the
+ * (cpu, socket, L3, NUMA node) of all ranks in tst->place_coord
+ */
+void placement_load(test_p tst) {
+	uint64_t *coord, *c;
+	int cpu, failed = 0;
+
+	if (tst->pin_policy > PIN_NONE)
+		failed = placement_pin(tst);
+	if (failed)
+		fprintf(stderr, "Rank %d: can not pin to a CPU, keeping the launcher's binding\n", my_rank);
+
+	coord = (uint64_t *)malloc(PLACE_WORDS * num_ranks * sizeof(uint64_t));
+	assert(coord != NULL);
+	c = coord + PLACE_WORDS * my_rank;
+	/* unpinned ranks may migrate: this is where they run now */
+	cpu = sched_getcpu();
+	if (cpu < 0) {
+		c[0] = c[1] = c[2] = c[3] = PLACE_NONE;
+	} else {
+		c[0] = (uint64_t)cpu;
+		c[1] = placement_socket(cpu);
+		c[2] = placement_l3(cpu);
+		c[3] = placement_numa(cpu);
+	}
+	comm_allgather64(coord, PLACE_WORDS);
+	tst->place_coord = coord;
+}
+
+/**
+ * \brief Releases the placements from placement_load()
+ */
+void placement_free(test_p tst) {
+	if (tst->place_coord != NULL)
+		free(tst->place_coord);
+	tst->place_coord = NULL;
+}
+
+/**
+ * \brief Placement class between two CPUs of this node
+ * \return PLACE_L3, PLACE_SOCKET, PLACE_CROSS, or PLACE_UNKNOWN if sysfs
+ * does not tell the sockets
+ */
+int placement_cpu_distance(int cpu_a, int cpu_b) {
+	uint64_t sa = placement_socket(cpu_a), sb = placement_socket(cpu_b), la;
+	if ((sa == PLACE_NONE) || (sb == PLACE_NONE))
+		return PLACE_UNKNOWN;
+	if (sa != sb)
+		return PLACE_CROSS;
+	la = placement_l3(cpu_a);
+	if ((la != PLACE_NONE) && (la == placement_l3(cpu_b)))
+		return PLACE_L3;
+	return PLACE_SOCKET;
+}
+
+/**
+ * \brief Placement class between two ranks of the same node
+ * \return PLACE_L3 for a shared L3 cache, PLACE_SOCKET for the same
+ * socket, PLACE_CROSS across sockets, PLACE_UNKNOWN without placements
+ * or for ranks on different nodes
+ */
+int placement_distance(test_p tst, int rank_a, int rank_b) {
+	uint64_t *a, *b;
+	if ((tst->place_coord == NULL) || (node_id[rank_a] != node_id[rank_b]))
+		return PLACE_UNKNOWN;
+	a = tst->place_coord + PLACE_WORDS * rank_a;
+	b = tst->place_coord + PLACE_WORDS * rank_b;
+	if ((a[1] == PLACE_NONE) || (b[1] == PLACE_NONE))
+		return PLACE_UNKNOWN;
+	if (a[1] != b[1])
+		return PLACE_CROSS;
+	if ((a[2] != PLACE_NONE) && (a[2] == b[2]))
+		return PLACE_L3;
+	return PLACE_SOCKET;
+}
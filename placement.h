@@ -0,0 +1,52 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+
+#ifndef HAVE_PLACEMENT_H
+#define HAVE_PLACEMENT_H
+
+#include "types.h"
+
+/* classes of on-node pairs by the CPUs they run on, nearest first */
+enum {PLACE_UNKNOWN=-1, PLACE_L3=0, PLACE_SOCKET=1, PLACE_CROSS=2};
+
+/* on-node placement classes (PLACE_L3..PLACE_CROSS) */
+#define PLACE_CLASSES 3
+
+/* pinning policies for tst->pin_policy */
+enum {PIN_OFF=-1, PIN_NONE=0, PIN_COMPACT=1, PIN_SCATTER=2};
+
+/* words per rank in tst->place_coord: cpu, socket, L3, NUMA node */
+#define PLACE_WORDS 4
+
+/* placement that could not be read from sysfs */
+#define PLACE_NONE (~((uint64_t)0))
+
+/**************************************************************
+ * FUNCTION PROTOTYPES
+ **************************************************************/
+void placement_load(test_p tst);
+void placement_free(test_p tst);
+int placement_distance(test_p tst, int rank_a, int rank_b);
+int placement_cpu_distance(int cpu_a, int cpu_b);
+
+#endif				/* HAVE_PLACEMENT_H */
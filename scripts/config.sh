@@ -61,6 +61,38 @@ case ${1} in
 		echo "#define NODEID_MPI"			>> config.h
 		echo "#endif"					>> config.h
 		: ;;
+	x86rdtscp)
+		echo "/* Generated by config.sh */"		>  config.h
+		echo "#ifndef HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define TIMER_X86_64_RDTSCP"		>> config.h
+		echo "#define NODEID_GETHOSTNAME"		>> config.h
+		echo "#endif"					>> config.h
+		: ;;
+	x86lfence)
+		echo "/* Generated by config.sh */"		>  config.h
+		echo "#ifndef HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define TIMER_X86_64_LFENCE"		>> config.h
+		echo "#define NODEID_GETHOSTNAME"		>> config.h
+		echo "#endif"					>> config.h
+		: ;;
+	aarch64)
+		echo "/* Generated by config.sh */"		>  config.h
+		echo "#ifndef HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define TIMER_AARCH64"		>> config.h
+		echo "#define NODEID_GETHOSTNAME"		>> config.h
+		echo "#endif"					>> config.h
+		: ;;
+	posix)
+		echo "/* Generated by config.sh */"		>  config.h
+		echo "#ifndef HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define HAVE_CONFIDENCE_CONFIG"		>> config.h
+		echo "#define TIMER_CLOCK_GETTIME"		>> config.h
+		echo "#define NODEID_GETHOSTNAME"		>> config.h
+		echo "#endif"					>> config.h
+		: ;;
 	*)
 		echo "Usage: $0 <target>"
 		echo "  valid values for target are:"
@@ -69,6 +101,10 @@ case ${1} in
 		echo "    ibmbgp     -- IBM BG/P       (MPI timers and MPI node-ids)"
 		echo "    sicortex   -- SiCortex       (MPI timers and SLURM node-ids)"
 		echo "    power7     -- IBM Power7     (MPI timers and MPI node-ids)"
+		echo "    x86rdtscp  -- x86-64         (RDTSCP timers and gethostname node-ids)"
+		echo "    x86lfence  -- x86-64         (LFENCE;RDTSC timers and gethostname node-ids)"
+		echo "    aarch64    -- ARMv8 cluster  (virtual counter timers and gethostname node-ids)"
+		echo "    posix      -- anything else  (clock_gettime timers and gethostname node-ids)"
 		: ;;
 esac
 	
@@ -22,6 +22,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <math.h>
 
 #include "copyright.h"
@@ -32,12 +34,18 @@
 #include "options.h"
 #include "orbtimer.h"
 #include "tests.h"
+#include "topology.h"
+#include "placement.h"
+#include "pairs.h"
+#include "outlier.h"
 #ifdef USE_XDD
 #  include "xdd_main.h"
 #endif
 
 int main(int argc, char *argv[]) {
 	measurement_p l,g;
+	char llabel[LABEL_LEN], glabel[LABEL_LEN];
+	int i;
 	test_p tst = (test_p)malloc(sizeof(test_t));
 
 	/* initialize communication and get options */
@@ -45,28 +53,59 @@ int main(int argc, char *argv[]) {
 	ROOTONLY printf("%s\n", COPYRIGHT);
 	general_options(tst,argc,argv);
 
-	/* create measurement structs */
-	l = measurement_create(tst, "local");
-	g = measurement_create(tst, "global");
 	ROOTONLY mkdir(tst->case_name, 0755);
+	/* per-rank output files need the directory */
+	comm_barrier();
+	/* exchange buffers are shared by every message size */
+	comm_newbuffers(tst);
 
-	ROOTONLY printf("Confidence: testing...\n");
-	measurement_collect(tst, l);
-	ROOTONLY printf("Confidence: local analysis...\n");
-	measurement_analyze(tst, l, -1.0);
-	ROOTONLY printf("Confidence: remote analysis\n");
-	comm_aggregate(g, l);
-	measurement_analyze(tst, g, -1.0);
-	ROOTONLY printf("Confidence: saving results\n");
-	measurement_serialize(tst, g, root_rank);
-
-	/* free measurement and test structs */
-	l = measurement_destroy(l);
-	g = measurement_destroy(g);
+	for (i = 0; i < tst->num_buf_lens; i++) {
+		tst->buf_len = tst->buf_lens[i];
+		/* a sweep labels each message size's files separately */
+		if (tst->num_buf_lens > 1) {
+			snprintf(llabel, LABEL_LEN, "local.B%d", tst->buf_len);
+			snprintf(glabel, LABEL_LEN, "global.B%d", tst->buf_len);
+			ROOTONLY printf("Confidence: message size %d bytes\n", tst->buf_len);
+		} else {
+			strcpy(llabel, "local");
+			strcpy(glabel, "global");
+		}
+
+		/* create measurement structs */
+		l = measurement_create(tst, llabel);
+		g = measurement_create(tst, glabel);
+
+		ROOTONLY printf("Confidence: testing...\n");
+		measurement_collect(tst, l);
+		ROOTONLY printf("Confidence: local analysis...\n");
+		measurement_analyze(tst, l, -1.0);
+		ROOTONLY printf("Confidence: remote analysis\n");
+		comm_aggregate(tst, g, l);
+		measurement_analyze(tst, g, -1.0);
+		ROOTONLY printf("Confidence: saving results\n");
+		measurement_serialize(tst, g, root_rank);
+		pairs_write(tst, l, glabel);
+		pairs_suspects(tst, l, glabel);
+		outlier_write(tst, l, glabel);
+
+		/* free measurement structs */
+		l = measurement_destroy(l);
+		g = measurement_destroy(g);
+	}
+
+	/* free buffers and test struct */
+	comm_freebuffers(tst);
+	free(tst->buf_lens);
 	if (tst->argv != NULL) 
 		free(tst->argv);
 	if (tst->tsdump != NULL)
 		free(tst->tsdump);
+	if (tst->topo_file != NULL)
+		free(tst->topo_file);
+	if (tst->cal_file != NULL)
+		free(tst->cal_file);
+	topology_free(tst);
+	placement_free(tst);
 	free(tst);
 
 	comm_finalize();
@@ -24,8 +24,10 @@
 #define _TESTS_H
 
 #include "types.h"
+#include "config.h"
+#include "orbtimer.h"
 
-enum {UNDEF=0, NET_TEST=1, BIT_TEST=2, IO_TEST=3};
+enum {UNDEF=0, NET_TEST=1, BIT_TEST=2, IO_TEST=3, WIN_TEST=4, COLL_TEST=5, C2C_TEST=6, FWQ_TEST=7, MEM_TEST=8, TIMER_TEST=9};
 
 /**************************************************************
  * FUNCTIONS
@@ -34,16 +36,31 @@ enum {UNDEF=0, NET_TEST=1, BIT_TEST=2, IO_TEST=3};
 	#define bit_test bit_SHMEM_test
 	#define net_test net_SHMEM_test
 	#define io_test io_SHMEM_test
+	#define win_test win_SHMEM_test
+	#define coll_test coll_SHMEM_test
 #else
 	#define bit_test bit_MPI_test
 	#define net_test net_MPI_test
 	#define io_test io_MPI_test
+	#define win_test win_MPI_test
+	#define coll_test coll_MPI_test
 #endif
 
 /* network latency test */
+#define NET_SYNC_ROUNDS 32	/* round trips per clock offset estimate (-s) */
 void 		net_SHMEM_test(test_p tst, measurement_p m);
 void 		net_MPI_test(test_p tst, measurement_p m);
-void 		net_measurement_bin(test_p tst, measurement_p m, double *t, double *cos, double *cpw, int LOCAL);
+void 		net_pack(ORB_tick_t *c, uint32_t *x, int n);
+void 		net_unpack(uint32_t *x, ORB_tick_t *c, int n, int partner);
+void 		net_pairwise(test_p tst, ORB_tick_t *cos, ORB_tick_t *cpw, int n);
+void 		net_oneway(test_p tst, ORB_tick_t *te, ORB_tick_t *tp, ORB_tick_t *cow, int n, double *s0, double *s1);
+void 		net_oneway_bin(test_p tst, measurement_p m, ORB_tick_t *cow, int n, int dist, ORB_tick_t *owmin, uint64_t *owskip);
+void 		net_oneway_binmin(test_p tst, measurement_p m, ORB_tick_t owmin, int dist);
+int 		net_families(test_p tst, int dist, int place, int *fam);
+int 		net_thread_family(test_p tst, int k, int dist);
+void 		net_measurement_bin(test_p tst, measurement_p m, ORB_tick_t *t, ORB_tick_t *cos, ORB_tick_t *cpw, int n,
+				    int nfam, int *fam, ORB_tick_t *cosmin, ORB_tick_t *cpwmin);
+void 		net_measurement_binmin(test_p tst, measurement_p m, ORB_tick_t cosmin, ORB_tick_t cpwmin, int nfam, int *fam);
 measurement_p 	net_measurement_create(test_p tst, char *label);
 
 /* network bit exchange test */
@@ -51,6 +68,36 @@ void 		bit_SHMEM_test(test_p tst, measurement_p m);
 void 		bit_MPI_test(test_p tst, measurement_p m);
 measurement_p 	bit_measurement_create(test_p tst, char *label);
 
+/* windowed non-blocking bandwidth and message-rate test */
+void 		win_SHMEM_test(test_p tst, measurement_p m);
+void 		win_MPI_test(test_p tst, measurement_p m);
+void 		win_measurement_bin(test_p tst, measurement_p m, ORB_tick_t *t, ORB_tick_t *cos, int LOCAL);
+measurement_p 	win_measurement_create(test_p tst, char *label);
+
+/* collective latency test */
+void 		coll_SHMEM_test(test_p tst, measurement_p m);
+void 		coll_MPI_test(test_p tst, measurement_p m);
+void 		coll_measurement_bin(test_p tst, measurement_p m, int k, ORB_tick_t *t, ORB_tick_t *c, ORB_tick_t *cmax);
+measurement_p 	coll_measurement_create(test_p tst, char *label);
+
+/* core-to-core cache line test (no communication, same for MPI and SHMEM) */
+void 		c2c_test(test_p tst, measurement_p m);
+measurement_p 	c2c_measurement_create(test_p tst, char *label);
+
+/* fixed work quantum OS noise test (no communication in the kernel) */
+void 		fwq_test(test_p tst, measurement_p m);
+measurement_p 	fwq_measurement_create(test_p tst, char *label);
+
+/* pointer-chasing memory latency test (no communication in the kernel) */
+#define MEM_CHASE 256	/* dependent loads per sample */
+#define MEM_MAX_NODES 1024	/* NUMA nodes the test can bind to (-u) */
+void 		mem_test(test_p tst, measurement_p m);
+measurement_p 	mem_measurement_create(test_p tst, char *label);
+
+/* timer comparison test (no communication in the kernel) */
+void 		timer_test(test_p tst, measurement_p m);
+measurement_p 	timer_measurement_create(test_p tst, char *label);
+
 /* ifdef XDD because the API isn't stable */
 #ifdef USE_XDD
 /* io test */
@@ -0,0 +1,408 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+
+/**
+ * \brief Compares the timers available on this host: each one is read
+ * back to back and the differences histogrammed, giving its overhead
+ * (median) and jitter (spread), alongside the compiled-in ORB timer.
+ *
+ * Pros: 
+ * - Shows which TIMER_<type> to configure for the lowest overhead and
+ *   the least jitter on a given machine, in the usual output format
+ * - Reports the resolution of coarse timers (gettimeofday) as well
+ *
+ * Cons:
+ * - Back-to-back reads show the cost of reading a timer, not how well
+ *   its ordering fences keep the timed code between the two reads
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "orbtimer.h"
+#include "comm.h"
+#include "tests.h"
+#include "measurement.h"
+
+#ifdef SHMEM
+	#include <mpp/shmem.h>
+#else
+	#include <mpi.h>
+#endif
+
+#if defined(__x86_64__)
+#	include <cpuid.h>
+#endif
+
+/* timers compared on this architecture */
+enum timer_backends {
+#if defined(__x86_64__)
+	/* TIMER_X86_64, TIMER_X86_64_LFENCE, TIMER_X86_64_RDTSCP, and unordered */
+	tmMfenceRdtsc, tmLfenceRdtsc, tmRdtscp, tmRdtsc,
+#elif defined(__aarch64__)
+	/* TIMER_AARCH64 */
+	tmCntvct,
+#elif defined(__powerpc64__)
+	/* TIMER_PPC64 */
+	tmMftb,
+#endif
+	/* TIMER_CLOCK_GETTIME, and the slewed clock */
+	tmMonotonicRaw, tmMonotonic,
+	/* TIMER_GTD */
+	tmGettimeofday,
+#ifndef SHMEM
+	/* TIMER_MPI_WTIME */
+	tmMpiWtime,
+#endif
+	TIMER_BACKENDS
+};
+
+/* number of timer histograms: the ORB timer, then one per backend */
+#define TIMER_LEN (1 + TIMER_BACKENDS)
+
+/* histogram of the compiled-in timer */
+#define timerTimer 0
+
+char *timer_labels[] = {
+	/* timer overhead */
+	"timer",
+#if defined(__x86_64__)
+	"mfenceRdtsc", "lfenceRdtsc", "rdtscp", "rdtsc",
+#elif defined(__aarch64__)
+	"cntvct",
+#elif defined(__powerpc64__)
+	"mftb",
+#endif
+	"monotonicRaw", "monotonic",
+	"gettimeofday",
+#ifndef SHMEM
+	"mpiWtime",
+#endif
+};
+
+/* interval over which counters of unknown frequency are calibrated */
+#define TIMER_CAL_USEC 100000
+
+#if defined(__x86_64__)
+static inline uint64_t timer_mfence_rdtsc() {
+	uint64_t t;
+	__asm__ __volatile__ ("mfence; rdtsc; movl %%eax,%%eax; salq $32,%%rdx; orq %%rdx,%%rax" : "=a" (t) : : "%rdx");
+	return t;
+}
+static inline uint64_t timer_lfence_rdtsc() {
+	uint64_t t;
+	__asm__ __volatile__ ("lfence; rdtsc; movl %%eax,%%eax; salq $32,%%rdx; orq %%rdx,%%rax" : "=a" (t) : : "%rdx");
+	return t;
+}
+static inline uint64_t timer_rdtscp() {
+	uint64_t t;
+	__asm__ __volatile__ ("rdtscp; movl %%eax,%%eax; salq $32,%%rdx; orq %%rdx,%%rax" : "=a" (t) : : "%rdx", "%rcx");
+	return t;
+}
+static inline uint64_t timer_rdtsc() {
+	uint64_t t;
+	__asm__ __volatile__ ("rdtsc; movl %%eax,%%eax; salq $32,%%rdx; orq %%rdx,%%rax" : "=a" (t) : : "%rdx");
+	return t;
+}
+#elif defined(__aarch64__)
+static inline uint64_t timer_cntvct() {
+	uint64_t t;
+	__asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r" (t) : : "memory");
+	return t;
+}
+#elif defined(__powerpc64__)
+static inline uint64_t timer_mftb() {
+	uint64_t t;
+	__asm__ __volatile__ ("mftb %0" : "=r" (t));
+	return t;
+}
+#endif
+static inline uint64_t timer_monotonic_raw() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+static inline uint64_t timer_monotonic() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+static inline uint64_t timer_gettimeofday() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
+}
+#ifndef SHMEM
+static inline uint64_t timer_mpi_wtime() {
+	return (uint64_t)(MPI_Wtime() * 1.0e+9);
+}
+#endif
+
+/* n pairs of back-to-back reads of one timer, inlined so no call is timed */
+#define TIMER_LOOP(READ) \
+	for (i = 0; i < n; i++) { \
+		a = READ(); \
+		b = READ(); \
+		d[i] = b - a; \
+	} \
+	break
+
+/**
+ \brief Reads backend k back to back n times
+ \param d Differences between the reads, in the backend's ticks
+*/
+static void timer_sample(int k, uint64_t *d, int n) {
+	uint64_t a, b;
+	int i;
+	switch (k) {
+#if defined(__x86_64__)
+		case tmMfenceRdtsc:	TIMER_LOOP(timer_mfence_rdtsc);
+		case tmLfenceRdtsc:	TIMER_LOOP(timer_lfence_rdtsc);
+		case tmRdtscp:		TIMER_LOOP(timer_rdtscp);
+		case tmRdtsc:		TIMER_LOOP(timer_rdtsc);
+#elif defined(__aarch64__)
+		case tmCntvct:		TIMER_LOOP(timer_cntvct);
+#elif defined(__powerpc64__)
+		case tmMftb:		TIMER_LOOP(timer_mftb);
+#endif
+		case tmMonotonicRaw:	TIMER_LOOP(timer_monotonic_raw);
+		case tmMonotonic:	TIMER_LOOP(timer_monotonic);
+		case tmGettimeofday:	TIMER_LOOP(timer_gettimeofday);
+#ifndef SHMEM
+		case tmMpiWtime:	TIMER_LOOP(timer_mpi_wtime);
+#endif
+		default:		break;
+	}
+}
+
+/**
+ \brief Ticks per second of backend k, 0.0 if this CPU can not read it
+
+ Clocks count known units. Counters report their frequency (cntvct), or
+ are timed against CLOCK_MONOTONIC_RAW over TIMER_CAL_USEC.
+*/
+static double timer_freq(int k) {
+	uint64_t c1 = 0, c2 = 0, n1, n2;
+#if defined(__x86_64__)
+	unsigned int a, b, c, d;
+#endif
+	switch (k) {
+		case tmMonotonicRaw:
+		case tmMonotonic:
+			return 1.0e+9;
+		case tmGettimeofday:
+			return 1.0e+6;
+#ifndef SHMEM
+		case tmMpiWtime:
+			return 1.0e+9;
+#endif
+#if defined(__x86_64__)
+		case tmRdtscp:
+			/* RDTSCP is CPUID 0x80000001 EDX bit 27 */
+			if (!__get_cpuid(0x80000001, &a, &b, &c, &d) || !(d & (1u << 27)))
+				return 0.0;
+			break;
+#elif defined(__aarch64__)
+		case tmCntvct:
+			__asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (c1));
+			return (double)c1;
+#endif
+		default:
+			break;
+	}
+	n1 = timer_monotonic_raw();
+	switch (k) {
+#if defined(__x86_64__)
+		case tmMfenceRdtsc:
+		case tmLfenceRdtsc:
+		case tmRdtscp:
+		case tmRdtsc:
+			c1 = timer_rdtsc();
+			usleep(TIMER_CAL_USEC);
+			c2 = timer_rdtsc();
+			break;
+#elif defined(__powerpc64__)
+		case tmMftb:
+			c1 = timer_mftb();
+			usleep(TIMER_CAL_USEC);
+			c2 = timer_mftb();
+			break;
+#endif
+		default:
+			break;
+	}
+	n2 = timer_monotonic_raw();
+	return (double)(c2 - c1) / ((double)(n2 - n1) / 1.0e+9);
+}
+
+/**
+ \brief Orders tick counts for the quantiles of the summary
+*/
+static int timer_cmp(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ \brief Writes the overhead and jitter of each backend to <label>.TIMER.<rank>
+ \param freq Ticks per second of each backend, 0.0 if not readable here
+ \param res Smallest non-zero difference of each backend, in ticks
+ \param min, med, p99, max Of each backend's differences in ticks, the
+ median and p99 summed over the cycles
+ \param sum, sum2 Sums of the differences and their squares, in seconds
+ \param n Samples of each backend
+*/
+static void timer_write(test_p tst, measurement_p m, double *freq, uint64_t *res, uint64_t *min, double *med, double *p99,
+			uint64_t *max, double *sum, double *sum2, uint64_t n, int cycles) {
+	char fname[FNAMESIZE];
+	double mean, sd;
+	FILE *F;
+	int k;
+
+	snprintf(fname, FNAMESIZE, "%s/%s.TIMER.%d", tst->case_name, m->label, my_rank);
+	F = fopen(fname, "w");
+	assert(F != NULL);
+	measurement_print_header(F, tst, m->label, NULL);
+	fprintf(F, "# Node:              %s (rank %d)\n", nodename, my_rank);
+	fprintf(F, "# Columns:           back-to-back read differences in nsec: resolution (smallest non-zero),\n");
+	fprintf(F, "#                    minimum, median and p99 (averaged over %d cycle(s)), maximum, and the\n", cycles);
+	fprintf(F, "#                    standard deviation (jitter); the timer frequency in Hz\n");
+	fprintf(F, "#%-14s %10s %10s %10s %10s %10s %10s %14s\n", "timer", "res", "min", "median", "p99", "max", "stddev", "freq");
+	for (k = 0; k < TIMER_BACKENDS; k++) {
+		if ((freq[k] <= 0.0) || (n == 0) || (cycles == 0)) {
+			fprintf(F, "%-15s %10s\n", timer_labels[1 + k], "unavailable");
+			continue;
+		}
+		mean = sum[k] / n;
+		sd = sum2[k] / n - mean * mean;
+		sd = (sd > 0.0) ? sqrt(sd) : 0.0;
+		fprintf(F, "%-15s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %14.10g\n", timer_labels[1 + k],
+			(res[k] > 0) ? (double)res[k] / freq[k] * 1.0e+9 : 0.0, (double)min[k] / freq[k] * 1.0e+9,
+			med[k] / cycles / freq[k] * 1.0e+9, p99[k] / cycles / freq[k] * 1.0e+9,
+			(double)max[k] / freq[k] * 1.0e+9, sd * 1.0e+9, freq[k]);
+	}
+	fclose(F);
+}
+
+/**
+ \brief Create the measurement struct for the test
+ \param tst Will tell the test how many times to run
+ \param label A label for the measurement struct
+*/
+measurement_p timer_measurement_create(test_p tst, char *label) {
+	int i;
+	measurement_p m = measurement_real_create(tst, label, TIMER_LEN);
+	for (i = 0; i < TIMER_LEN; i++)
+		strncpy(m->hist[i].label,timer_labels[i],LABEL_LEN);
+	/* adaptive sampling watches every backend */
+	for (i = 1; i < TIMER_LEN; i++)
+		m->hist[i].converge = 1;
+	return m;
+}
+
+/**
+ \brief Reads every timer of this host tst->num_messages times back to
+ back per cycle, and histograms the differences in seconds
+ \param tst Gives the cycles, warmups and samples per timer
+ \param m Collects measurement data from the test
+
+ No messages are exchanged between ranks, only the per-cycle time limit
+ and adaptive sampling checks are collective.
+*/
+void timer_test(test_p tst, measurement_p m) {
+	uint64_t *d, res[TIMER_BACKENDS], min[TIMER_BACKENDS], max[TIMER_BACKENDS], n = 0;
+	double freq[TIMER_BACKENDS], med[TIMER_BACKENDS], p99[TIMER_BACKENDS];
+	double sum[TIMER_BACKENDS], sum2[TIMER_BACKENDS], s;
+	int i, k, icycle, cycles = 0, stop = 0;
+	ORB_t t1, t2;
+
+	d = (uint64_t *)malloc(tst->num_messages * sizeof(uint64_t));	/* array for read differences */
+	assert(d != NULL);
+
+	/* calibrate the ORB timer, then the frequencies of the others */
+	measurement_calibrate(tst);
+	for (k = 0; k < TIMER_BACKENDS; k++) {
+		freq[k] = timer_freq(k);
+		res[k] = max[k] = 0;
+		min[k] = ~((uint64_t)0);
+		med[k] = p99[k] = sum[k] = sum2[k] = 0.0;
+	}
+	comm_barrier();
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
+		comm_barrier();
+		/* the compiled-in timer, as the other tests measure it */
+		for (i = 0; i < tst->num_messages; i++) {
+			ORB_read(t1);
+			ORB_read(t2);
+			MEASUREMENT_BIN(m, timerTimer, tick2bin(tst,ORB_cycles_u(t2, t1)))++;
+		}
+		/***************************************************************/
+		/* BEGIN PERFORMANCE KERNEL -- back-to-back reads of each timer */
+		/***************************************************************/
+		for (k = 0; k < TIMER_BACKENDS; k++) {
+			if (freq[k] <= 0.0)
+				continue;
+			/* warm-up */
+			timer_sample(k, d, (tst->num_warmup < tst->num_messages) ? tst->num_warmup : tst->num_messages);
+			timer_sample(k, d, tst->num_messages);
+			for (i = 0; i < tst->num_messages; i++) {
+				s = (double)d[i] / freq[k];
+				MEASUREMENT_BIN(m, 1 + k, time2bin(tst, s))++;
+				sum[k] += s;
+				sum2[k] += s * s;
+				if ((d[i] > 0) && ((res[k] == 0) || (d[i] < res[k])))
+					res[k] = d[i];
+			}
+			qsort(d, tst->num_messages, sizeof(uint64_t), timer_cmp);
+			if (d[0] < min[k])
+				min[k] = d[0];
+			if (d[tst->num_messages - 1] > max[k])
+				max[k] = d[tst->num_messages - 1];
+			med[k] += (double)d[tst->num_messages / 2];
+			p99[k] += (double)d[(int)(0.99 * (tst->num_messages - 1))];
+		}
+		/***************************************************************/
+		/* END PERFORMANCE KERNEL -- timers of this cycle read         */
+		/***************************************************************/
+		n += tst->num_messages;
+		cycles++;
+		/* out of time? all ranks stop after the same cycle */
+		stop = comm_time_expired(tst);
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
+	}
+
+	timer_write(tst, m, freq, res, min, med, p99, max, sum, sum2, n, cycles);
+	free(d);
+	return;
+}
@@ -0,0 +1,153 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+/**
+ * \brief Network topology for distance classes between ranks
+ *
+ * A topology file lists one node per line as
+ *
+ *     <nodename> <group> <switch>
+ *
+ * where the node id is taken from the digits of <nodename>, as
+ * comm_getnodeid() does for the local node, and <switch> is numbered
+ * within its <group>. Blank lines and lines starting with '#' are skipped.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "comm.h"
+#include "topology.h"
+
+/* one line of the topology file */
+typedef struct topo_entry {
+	uint64_t id;		/* node id */
+	uint64_t group;		/* group (eg. dragonfly group, cabinet) */
+	uint64_t sw;		/* switch within the group */
+} topo_entry_t;
+
+/**
+ * \brief Orders topology entries by node id for bsearch
+ */
+static int topology_cmp(const void *a, const void *b) {
+	uint64_t x = ((const topo_entry_t *)a)->id;
+	uint64_t y = ((const topo_entry_t *)b)->id;
+	return (x > y) - (x < y);
+}
+
+/**
+ * \brief Reads tst->topo_file on root_rank and gives every rank the
+ * (group, switch) coordinates of all ranks in tst->topo_coord
+ * \param tst Names the topology file; exits on every rank if it can not be read
+ */
+void topology_load(test_p tst) {
+	uint64_t *coord;
+	int i, ok = 1, unmapped = 0;
+
+	coord = (uint64_t *)malloc(2 * num_ranks * sizeof(uint64_t));
+	assert(coord != NULL);
+	for (i = 0; i < 2 * num_ranks; i++)
+		coord[i] = TOPO_NONE;
+
+	ROOTONLY {
+		char line[NAMEBUFFSIZE], name[NAMEBUFFSIZE];
+		unsigned long long group, sw;
+		topo_entry_t *entries = NULL, key, *e;
+		size_t n = 0, len = 0;
+		FILE *f = fopen(tst->topo_file, "r");
+		if (f == NULL) {
+			fprintf(stderr, "Can not open topology file: %s\n", tst->topo_file);
+			ok = 0;
+		} else {
+			while (fgets(line, NAMEBUFFSIZE, f) != NULL) {
+				if (line[0] == '#')
+					continue;
+				if (sscanf(line, "%255s %llu %llu", name, &group, &sw) != 3)
+					continue;
+				if (n == len) {
+					len = (len == 0) ? 1024 : 2 * len;
+					entries = (topo_entry_t *)realloc(entries, len * sizeof(topo_entry_t));
+					assert(entries != NULL);
+				}
+				entries[n].id = comm_name2nodeid(name);
+				entries[n].group = group;
+				entries[n].sw = sw;
+				n++;
+			}
+			fclose(f);
+			/* look up the node of every rank */
+			if (n > 0)
+				qsort(entries, n, sizeof(topo_entry_t), topology_cmp);
+			for (i = 0; i < num_ranks; i++) {
+				key.id = node_id[i];
+				e = (n > 0) ? (topo_entry_t *)bsearch(&key, entries, n, sizeof(topo_entry_t), topology_cmp) : NULL;
+				if (e == NULL) {
+					unmapped++;
+					continue;
+				}
+				coord[2 * i] = e->group;
+				coord[2 * i + 1] = e->sw;
+			}
+			if (unmapped > 0)
+				fprintf(stderr, "Topology: %d rank(s) on nodes missing from %s are binned as off-node only\n",
+					unmapped, tst->topo_file);
+			free(entries);
+		}
+	}
+	if (!comm_root_flag(ok))
+		exit(1);
+	comm_broadcast64(coord, 2 * num_ranks);
+	tst->topo_coord = coord;
+}
+
+/**
+ * \brief Releases the coordinates from topology_load()
+ */
+void topology_free(test_p tst) {
+	if (tst->topo_coord != NULL)
+		free(tst->topo_coord);
+	tst->topo_coord = NULL;
+}
+
+/**
+ * \brief Distance class between two ranks
+ * \return TOPO_NODE for the same node, TOPO_SWITCH, TOPO_GROUP or
+ * TOPO_SYSTEM with a topology, TOPO_UNKNOWN for other off-node pairs
+ */
+int topology_distance(test_p tst, int rank_a, int rank_b) {
+	uint64_t *a, *b;
+	if (node_id[rank_a] == node_id[rank_b])
+		return TOPO_NODE;
+	if (tst->topo_coord == NULL)
+		return TOPO_UNKNOWN;
+	a = tst->topo_coord + 2 * rank_a;
+	b = tst->topo_coord + 2 * rank_b;
+	if ((a[0] == TOPO_NONE) || (b[0] == TOPO_NONE))
+		return TOPO_UNKNOWN;
+	if (a[0] != b[0])
+		return TOPO_SYSTEM;
+	if (a[1] != b[1])
+		return TOPO_GROUP;
+	return TOPO_SWITCH;
+}
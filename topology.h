@@ -0,0 +1,44 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+#ifndef HAVE_TOPOLOGY_H
+#define HAVE_TOPOLOGY_H
+
+#include "types.h"
+
+/* distance classes between two ranks, nearest first */
+enum {TOPO_UNKNOWN=-1, TOPO_NODE=0, TOPO_SWITCH=1, TOPO_GROUP=2, TOPO_SYSTEM=3};
+
+/* off-node distance classes (TOPO_SWITCH..TOPO_SYSTEM) */
+#define TOPO_CLASSES 3
+
+/* coordinate of a rank whose node is missing from the topology file */
+#define TOPO_NONE (~((uint64_t)0))
+
+/**************************************************************
+ * FUNCTION PROTOTYPES
+ **************************************************************/
+void topology_load(test_p tst);
+void topology_free(test_p tst);
+int topology_distance(test_p tst, int rank_a, int rank_b);
+
+#endif				/* HAVE_TOPOLOGY_H */
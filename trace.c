@@ -0,0 +1,168 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+/**
+ * \brief Raw per-sample trace of the net test
+ *
+ * Each rank streams its samples to <case_name>/<label>.TRACE.<rank>: a
+ * header
+ *
+ *     char magic[8]; uint64_t rank, node_id, buflen; double ticks_per_second;
+ *
+ * followed by trace_rec_t records in native byte order. Records are
+ * appended to one of two buffers between pairs; a full buffer is handed
+ * to a writer thread and the other buffer takes over, so the test only
+ * waits on the file system if the writer falls a whole buffer behind.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "types.h"
+#include "comm.h"
+#include "trace.h"
+
+/**
+ * \brief Writer thread: drains handed-over buffers until the trace is closed
+ */
+static void *trace_writer(void *arg) {
+	trace_p tr = (trace_p)arg;
+	int b;
+	size_t len;
+	pthread_mutex_lock(&tr->lock);
+	for (;;) {
+		while ((tr->pending < 0) && !tr->done)
+			pthread_cond_wait(&tr->cond, &tr->lock);
+		if (tr->pending < 0)
+			break;
+		b = tr->pending;
+		len = tr->pending_len;
+		pthread_mutex_unlock(&tr->lock);
+		fwrite(tr->buf[b], sizeof(trace_rec_t), len, tr->file);
+		pthread_mutex_lock(&tr->lock);
+		tr->pending = -1;
+		pthread_cond_broadcast(&tr->cond);
+	}
+	pthread_mutex_unlock(&tr->lock);
+	return NULL;
+}
+
+/**
+ * \brief Hands the active buffer to the writer and switches buffers
+ */
+static void trace_flush(trace_p tr) {
+	pthread_mutex_lock(&tr->lock);
+	/* the writer must be done with the other buffer */
+	while (tr->pending >= 0)
+		pthread_cond_wait(&tr->cond, &tr->lock);
+	tr->pending = tr->active;
+	tr->pending_len = tr->fill;
+	tr->active ^= 1;
+	tr->fill = 0;
+	pthread_cond_broadcast(&tr->cond);
+	pthread_mutex_unlock(&tr->lock);
+}
+
+/**
+ * \brief Opens this rank's trace of a measurement and starts its writer
+ * \param m The measurement, for the label and message size
+ * \return The trace
+ */
+trace_p trace_open(test_p tst, measurement_p m) {
+	char fname[FNAMESIZE], magic[8];
+	uint64_t hdr[3];
+	double freq = ORB_REFFREQ;
+	int ierr;
+	trace_p tr = (trace_p)malloc(sizeof(trace_t));
+	assert(tr != NULL);
+
+	snprintf(fname, FNAMESIZE, "%s/%s.TRACE.%d", tst->case_name, m->label, my_rank);
+	tr->file = fopen(fname, "wb");
+	assert(tr->file != NULL);
+	memset(magic, 0, sizeof(magic));
+	strncpy(magic, TRACE_MAGIC, sizeof(magic));
+	hdr[0] = my_rank;
+	hdr[1] = node_id[my_rank];
+	hdr[2] = m->buflen;
+	fwrite(magic, sizeof(magic), 1, tr->file);
+	fwrite(hdr, sizeof(uint64_t), 3, tr->file);
+	fwrite(&freq, sizeof(double), 1, tr->file);
+
+	tr->buf[0] = (trace_rec_t *)malloc(TRACE_BUFFER * sizeof(trace_rec_t));
+	tr->buf[1] = (trace_rec_t *)malloc(TRACE_BUFFER * sizeof(trace_rec_t));
+	assert((tr->buf[0] != NULL) && (tr->buf[1] != NULL));
+	tr->active = 0;
+	tr->fill = 0;
+	tr->pending = -1;
+	tr->pending_len = 0;
+	tr->done = 0;
+	pthread_mutex_init(&tr->lock, NULL);
+	pthread_cond_init(&tr->cond, NULL);
+	ierr = pthread_create(&tr->writer, NULL, trace_writer, tr);
+	assert(ierr == 0);
+	return tr;
+}
+
+/**
+ * \brief Appends the samples of one visit to a partner
+ * \param ts Start of each sample in ticks since the start of collection
+ * \param cos One-sided timings (ticks)
+ * \param cpw Pairwise timings (ticks)
+ * \param n Number of samples
+ */
+void trace_stage(trace_p tr, ORB_tick_t *ts, ORB_tick_t *cos, ORB_tick_t *cpw, int n, int partner, int cycle) {
+	trace_rec_t *r;
+	int i;
+	for (i = 0; i < n; i++) {
+		if (tr->fill == TRACE_BUFFER)
+			trace_flush(tr);
+		r = tr->buf[tr->active] + tr->fill++;
+		r->tick = ts[i];
+		r->os = cos[i];
+		r->pw = cpw[i];
+		r->partner = partner;
+		r->cycle = cycle;
+	}
+}
+
+/**
+ * \brief Writes the remaining samples, stops the writer and closes the file
+ * \return NULL
+ */
+trace_p trace_close(trace_p tr) {
+	if (tr->fill > 0)
+		trace_flush(tr);
+	pthread_mutex_lock(&tr->lock);
+	while (tr->pending >= 0)
+		pthread_cond_wait(&tr->cond, &tr->lock);
+	tr->done = 1;
+	pthread_cond_broadcast(&tr->cond);
+	pthread_mutex_unlock(&tr->lock);
+	pthread_join(tr->writer, NULL);
+	pthread_mutex_destroy(&tr->lock);
+	pthread_cond_destroy(&tr->cond);
+	fclose(tr->file);
+	free(tr->buf[0]);
+	free(tr->buf[1]);
+	free(tr);
+	return NULL;
+}
@@ -0,0 +1,69 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+
+#ifndef HAVE_TRACE_H
+#define HAVE_TRACE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "types.h"
+#include "config.h"
+#include "orbtimer.h"
+
+/* records per trace buffer (two buffers per rank) */
+#define TRACE_BUFFER 65536
+
+/* first bytes of a TRACE file */
+#define TRACE_MAGIC "SCTRACE"
+
+/* one raw sample */
+typedef struct trace_rec {
+	uint64_t tick;		/* start of the sample, in ticks since the start of collection */
+	uint64_t os;		/* one-sided timing (ticks) */
+	uint64_t pw;		/* pairwise timing (ticks) */
+	int32_t partner;	/* partner rank */
+	uint32_t cycle;		/* cycle */
+} trace_rec_t;
+
+/* double-buffered trace writer of one rank */
+typedef struct trace {
+	FILE *file;
+	trace_rec_t *buf[2];	/* the kernel fills one while the writer drains the other */
+	int active;		/* buffer being filled */
+	size_t fill;		/* records in the active buffer */
+	int pending;		/* buffer handed to the writer, -1 if none */
+	size_t pending_len;	/* records in the pending buffer */
+	int done;		/* no more buffers will come */
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+} trace_t;
+typedef trace_t* trace_p;
+
+/**************************************************************
+ * FUNCTION PROTOTYPES
+ **************************************************************/
+trace_p trace_open(test_p tst, measurement_p m);
+void trace_stage(trace_p tr, ORB_tick_t *ts, ORB_tick_t *cos, ORB_tick_t *cpw, int n, int partner, int cycle);
+trace_p trace_close(trace_p tr);
+
+#endif				/* HAVE_TRACE_H */
@@ -31,11 +31,18 @@
  * FNAMESIZE    -- measurement outfile filenames length
  * NAMEBUFFSIZE -- POSIX and OpenMPI both require at least 256
  *                 while UNIX requires 8-14
+ * CACHELINE    -- alignment in bytes of histogram storage
+ * TEST_BUFFERS -- number of exchange buffers shared by the tests
  * ROOTONLY     -- readabililty macro for that serial stuff
  **************************************************************/
 #define LABEL_LEN 64
 #define FNAMESIZE 512
 #define NAMEBUFFSIZE 256
+#define CACHELINE 64
+#define TEST_BUFFERS 3
+#define MAX_QUANTILES 8
+/* most thread counts in one threaded net test (-p) */
+#define MAX_THREAD_COUNTS 8
 #define NODIVIDEBYZERO(_N_) ( (_N_ == 0) ? (1) : (_N_))
 
 
@@ -48,6 +55,7 @@ typedef struct buffer {
 	void *data;		/* buffer data */
 	size_t len;		/* buffer length in bytes */
 } buffer_t;
+typedef buffer_t* buffer_p;
 
 /* holds distribution and stats for timings */
 typedef struct histogram {
@@ -61,9 +69,16 @@ typedef struct histogram {
 	double m30, m3m, m3s;	/* 3rd moment: 0,min,scaled */
 	double m40, m4m, m4s;	/* 4th moment: 0,min,scaled */
 	uint64_t nsamples;	/* number of samples in the distribution */
-	uint64_t *dist;		/* pointer to histogram array: dist[nbins] */
+	double bytes;		/* bytes moved per sample (0 if not a transfer) */
+	double messages;	/* messages completed per sample (0 if not a transfer) */
+	uint64_t *dist;		/* pointer to histogram array: dist[nbins*stride] */
+	size_t stride;		/* distance between consecutive bins in dist */
+	char converge;		/* adaptive sampling watches this histogram (yes/no) */
 } histogram_t;
 
+/* bin b of histogram h */
+#define HIST_BIN(_H_,_B_) ( (_H_)->dist[(size_t)(_B_) * (_H_)->stride] )
+
 /* group histograms together */
 typedef struct measurement {
 	char label[LABEL_LEN];	/* label */
@@ -73,8 +88,19 @@ typedef struct measurement {
 	double timer_oh;	/* timer overhead in seconds */
 	int num_histograms;	/* number of histograms in the array */
 	histogram_t *hist;	/* array of histograms for this measurement */
+	int layout;		/* arena layout (LAYOUT_HISTMAJOR, LAYOUT_BINMAJOR) */
+	uint64_t *dist;		/* arena holding the bins of all histograms */
+	size_t dist_len;	/* number of counters in the arena, including padding */
+	size_t hstride;		/* distance between histograms in dist */
+	size_t bstride;		/* distance between bins in dist */
+	uint64_t *pairs;	/* per-partner summaries (net test -P), NULL if not kept */
+	uint64_t *oneway;	/* per-partner one-way summaries (net test -P -s), NULL if not kept */
+	struct outlier *outliers; /* ring of slow samples (-U), NULL if not kept */
 } measurement_t;
 
+/* bin b of histogram h in measurement m */
+#define MEASUREMENT_BIN(_M_,_H_,_B_) ( (_M_)->dist[(size_t)(_H_) * (_M_)->hstride + (size_t)(_B_) * (_M_)->bstride] )
+
 /* config options for each test */
 typedef struct test {
 	/* name for this test */
@@ -83,20 +109,53 @@ typedef struct test {
 	int test_type;
 	/* define how to run through the test*/
 	int num_stages;
+	int schedule;           /* all-pairs schedule (SCHED_XOR, SCHED_ROUNDROBIN) */
 	int num_warmup;         /* keep this < 1% of num_messages */
 	int num_messages;       /* messages per cycle*/
+	int chunk;              /* net test: samples timed, exchanged and binned at a time */
+	int num_thread_counts;  /* threaded net test: number of thread counts (0: off) */
+	int thread_counts[MAX_THREAD_COUNTS]; /* threaded net test: threads per rank, each a family */
+	double fwq_quantum;     /* FWQ test: seconds of work per quantum */
+	int mem_node;           /* memory test: NUMA node of the working sets (-1: local) */
+	int window;             /* messages in flight per window (win test) */
 	int num_cycles;         /* how many times to cycle through the test */
+	double time_limit;      /* seconds of collection per message size (0: no limit) */
+	double ci_tolerance;    /* adaptive sampling: relative CI half-width to stop at (0: off) */
+	int num_quantiles;      /* adaptive sampling: number of quantiles watched */
+	double quantiles[MAX_QUANTILES]; /* adaptive sampling: quantiles watched */
 	/* uint64_t total_messages; */ /* num_cycles * num_messages * (num_ranks-1) */
 	/* histogram options */
 	int num_bins;           /* number of bins */
 	double bin_size;        /* size of bin in seconds */
 	double max_hist_time;   /* max histogram time in seconds */
 	double hist_scale;      /* histogram scale in seconds */
+	int hist_layout;        /* measurement arena layout */
 	/* message size */
-	int buf_len;
+	int buf_len;            /* message size of the current measurement */
+	int *buf_lens;          /* message sizes to sweep through */
+	int num_buf_lens;       /* number of message sizes */
+	buffer_p buf[TEST_BUFFERS]; /* exchange buffers, sized for the largest message */
+	char calibrated;        /* ORB_calibrate() has run (yes/no) */
 	/* misc options */
-	char log_binning;       /* logarithmic binning (yes/no) */
+	char log_binning;       /* binning (BIN_LINEAR, BIN_LOG, BIN_LOGLINEAR) */
+	int subbucket_bits;     /* log-linear binning: 2^bits bins per octave of ticks */
 	char rank_mapping;      /* whether to output rank mapping */
+	char reduce_root;       /* aggregate results on root_rank only (yes/no) */
+	char dense_output;      /* HIST/PDF/CDF files list every bin, not only those with samples (yes/no) */
+	char pair_matrix;       /* keep per-partner summaries (net test) (yes/no) */
+	char oneway;            /* estimate pair clock offsets and bin one-way latencies (net test, MPI) (yes/no) */
+	double suspect_k;       /* suspects report threshold in robust deviations (0: no report) */
+	char trace;             /* stream raw samples to per-rank trace files (net test) (yes/no) */
+	double outlier_threshold; /* outlier log threshold in seconds, OUTLIER_AUTO, or 0 for no log */
+	int outlier_events;     /* outlier ring size per rank */
+	/* network topology for distance classes (net test) */
+	char *topo_file;        /* topology file, NULL for on-node/off-node only */
+	uint64_t *topo_coord;   /* (group, switch) of each rank, from topology_load() */
+	/* CPU placement for on-node classes (net test) */
+	int pin_policy;         /* PIN_OFF (no classes), PIN_NONE, PIN_COMPACT, PIN_SCATTER */
+	uint64_t *place_coord;  /* (cpu, socket, L3, NUMA node) of each rank, from placement_load() */
+	/* timer calibration */
+	char *cal_file;         /* calibration cache file, NULL for none */
 	/* arguments to pass to io test */
 	int argc;
 	char **argv;
@@ -106,7 +165,6 @@ typedef struct test {
 } test_t;
 
 /* pointer types */
-typedef buffer_t* buffer_p;
 typedef histogram_t* histogram_p;
 typedef measurement_t* measurement_p;
 typedef test_t* test_p;
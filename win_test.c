@@ -0,0 +1,311 @@
+/*
+  This file is part of SystemConfidence.
+
+  Copyright (C) 2012, UT-Battelle, LLC.
+
+  This product includes software produced by UT-Battelle, LLC under Contract No. 
+  DE-AC05-00OR22725 with the Department of Energy. 
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the New BSD 3-clause software license (LICENSE). 
+  
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the 
+  LICENSE for more details.
+
+  For more information please contact the SystemConfidence developers at: 
+  systemconfidence-info@googlegroups.com
+
+*/
+
+/**
+ * \brief Tests windows of non-blocking messages in flight between each pair,
+ * timing the completion of each window.
+ *
+ * Pros: 
+ * - Assesses the fabric under pipelined traffic, as seen by halo exchanges
+ * - Reports bandwidth and message-rate distributions alongside latency
+ *
+ * Cons:
+ * - Only one-sided (per-rank) window times, no pairwise combination
+ * - Requires a receive buffer of window * buflen bytes
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "config.h"
+#include "orbtimer.h"
+#include "comm.h"
+#include "tests.h"
+#include "measurement.h"
+
+#ifdef SHMEM
+	#include <mpp/shmem.h>
+#else
+	#include <mpi.h>
+#endif
+
+/* number of window histograms */
+#define WIN_LEN 5
+
+/* histograms for window measurements */
+enum win_vars {
+	/* timer overhead */
+	winTimer,
+	/* local communication */
+	onNodeWindow, onNodeWindowMinimum,
+	/* remote communication */
+	offNodeWindow, offNodeWindowMinimum
+};
+
+/* distance from a window histogram to its per-pair minimum histogram */
+#define WIN_MIN (onNodeWindowMinimum - onNodeWindow)
+
+char *win_labels[] = {
+	/* timer overhead */
+	"timer",
+	/* local communication */
+	"onNodeWindow", "onNodeWindowMinimum",
+	/* remote communication */
+	"offNodeWindow", "offNodeWindowMinimum"
+};
+
+/**
+ \brief Create the measurement struct for the test
+ \param tst Gives the window size and message length
+ \param label A label for the measurement struct
+*/
+measurement_p win_measurement_create(test_p tst, char *label) {
+	int i;
+	measurement_p m = measurement_real_create(tst, label, WIN_LEN);
+	for (i = 0; i < WIN_LEN; i++) {
+		strncpy(m->hist[i].label,win_labels[i],LABEL_LEN);
+		/* each window sample moves this much data in each direction */
+		if (i != winTimer) {
+			m->hist[i].messages = (double)tst->window;
+			m->hist[i].bytes = (double)tst->window * (double)tst->buf_len;
+		}
+	}
+	/* adaptive sampling watches the per-window histograms */
+	m->hist[onNodeWindow].converge = m->hist[offNodeWindow].converge = 1;
+	return m;
+}
+
+/**
+ \brief Puts windows of messages to each partner, timing each window to completion
+ \param tst Gives the window size, cycles and number of windows per pair
+ \param m Collects measurement data from the test
+*/
+void win_SHMEM_test(test_p tst, measurement_p m) {
+#ifdef SHMEM
+	static int sync;
+	sync = my_rank;
+	buffer_t *sbuf, *rbuf;
+	ORB_tick_t *cos, *t;
+	int i, j, icycle, istage, partner_rank, stop = 0;
+	ORB_t t1, t2, t3;
+//Make
+	sbuf = tst->buf[0];	/* send buffer */
+	rbuf = comm_newbuffer((size_t)tst->window * m->buflen);	/* one receive slot per message in the window */
+	cos = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for window timings */
+	assert(cos != NULL);
+	t = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for timer overhead timings */
+	assert(t != NULL);
+
+// Exec
+	/* calibrate timer */
+	measurement_calibrate(tst);
+	/* pre-synchronize all tasks */
+	shmem_barrier_all();
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
+		/* step through the stage schedule */
+		for (istage = 0; istage < tst->num_stages; istage++) {
+			/* out of time? all ranks stop at the same stage boundary */
+			if ((stop = comm_time_expired(tst)))
+				break;
+			shmem_barrier_all();
+			/* who's my buddy for this stage? */
+			partner_rank = comm_partner(tst, istage);
+			/* valid pairing */
+			if (partner_rank >= 0) {
+				/* warm-up */
+				for (i = 0; i < tst->num_warmup; i++) {
+					for (j = 0; j < tst->window; j++)
+						shmem_putmem((char *)rbuf->data + (size_t)j * m->buflen, sbuf->data,
+							     m->buflen, partner_rank);
+					shmem_quiet();
+				}
+				
+				/* synchronize partners */
+				shmem_int_p(&sync, my_rank, partner_rank);
+				shmem_int_wait_until(&sync, SHMEM_CMP_EQ, partner_rank);
+				sync = my_rank;
+				
+				/************************************************************/
+				/* BEGIN PERFORMANCE KERNEL -- gather samples for this pair */
+				/************************************************************/
+				for (i = 0; i < tst->num_messages; i++) {
+					ORB_read(t1);
+					ORB_read(t2);
+					for (j = 0; j < tst->window; j++)
+						shmem_putmem((char *)rbuf->data + (size_t)j * m->buflen, sbuf->data,
+							     m->buflen, partner_rank);
+					shmem_quiet();
+					ORB_read(t3);
+					t[i] = ORB_cycles(t2, t1);
+					cos[i] = ORB_cycles(t3, t2);
+				}
+				/************************************************************/
+				/* END PERFORMANCE KERNEL -- samples gathered for this pair */
+				/************************************************************/
+				
+				/* ensure partner is done writing to our window */
+				shmem_int_p(&sync, my_rank, partner_rank);
+				shmem_int_wait_until(&sync, SHMEM_CMP_EQ, partner_rank);
+				sync = my_rank;
+
+				win_measurement_bin(tst, m, t, cos, (node_id[my_rank] == node_id[partner_rank]));
+			} /* if valid pairing */
+		} /* for istage */
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
+	} /* for icycle */
+
+// Kill
+	shmem_barrier_all();
+	free(t);
+	free(cos);
+	comm_freebuffer(rbuf);
+#endif
+	return;
+}
+
+#ifndef SHMEM
+/**
+ \brief Posts one window of receives and sends to the partner and waits for all of them
+ \return sum of the MPI error codes
+*/
+static int win_MPI_window(test_p tst, measurement_p m, buffer_p sbuf, buffer_p rbuf, MPI_Request *req, int partner_rank) {
+	int j, ierr = 0;
+	for (j = 0; j < tst->window; j++)
+		ierr += MPI_Irecv((char *)rbuf->data + (size_t)j * m->buflen, m->buflen, MPI_BYTE,
+				  partner_rank, 1, MPI_COMM_WORLD, &req[j]);
+	for (j = 0; j < tst->window; j++)
+		ierr += MPI_Isend(sbuf->data, m->buflen, MPI_BYTE,
+				  partner_rank, 1, MPI_COMM_WORLD, &req[tst->window + j]);
+	ierr += MPI_Waitall(2 * tst->window, req, MPI_STATUSES_IGNORE);
+	return ierr;
+}
+#endif
+
+/**
+ \brief Exchanges windows of non-blocking messages with each partner, timing each window to completion
+ \param tst Gives the window size, cycles and number of windows per pair
+ \param m Collects measurement data from the test
+*/
+void win_MPI_test(test_p tst, measurement_p m) {
+#ifndef SHMEM
+	buffer_t *sbuf, *rbuf;
+	ORB_tick_t *cos, *t;
+	MPI_Request *req;
+	int i, icycle, istage, ierr, partner_rank, stop = 0;
+	ORB_t t1, t2, t3;
+	sbuf = tst->buf[0];	/* send buffer, shared by all sends of a window */
+	rbuf = comm_newbuffer((size_t)tst->window * m->buflen);	/* one receive slot per message in the window */
+	req = (MPI_Request *)malloc(2 * tst->window * sizeof(MPI_Request));
+	assert(req != NULL);
+	cos = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for window timings */
+	assert(cos != NULL);
+	t = (ORB_tick_t *)malloc(tst->num_messages * sizeof(ORB_tick_t));	/* array for timer overhead timings */
+	assert(t != NULL);
+	/* calibrate timer */
+	measurement_calibrate(tst);
+	/* pre-synchronize all tasks */
+	ierr = MPI_Barrier(MPI_COMM_WORLD);
+	comm_time_start(tst);
+	for (icycle = 0; (icycle < tst->num_cycles) && !stop; icycle++) {
+		/* step through the stage schedule */
+		for (istage = 0; istage < tst->num_stages; istage++) {
+			/* out of time? all ranks stop at the same stage boundary */
+			if ((stop = comm_time_expired(tst)))
+				break;
+			/* who's my buddy for this stage? */
+			partner_rank = comm_partner(tst, istage);
+			/* valid pairing */
+			if (partner_rank >= 0) {
+				ierr = 0;
+				/***************************************/
+				/* warm-up / pre-synchronize this pair */
+				/***************************************/
+				for (i = 0; i < tst->num_warmup; i++) {
+					ierr += win_MPI_window(tst, m, sbuf, rbuf, req, partner_rank);
+				}
+				assert(ierr == 0);
+				/************************************************************/
+				/* BEGIN PERFORMANCE KERNEL -- gather samples for this pair */
+				/************************************************************/
+				for (i = 0; i < tst->num_messages; i++) {
+					/* for timer overhead estimate */
+					ORB_read(t1);
+					ORB_read(t2);
+					/**************************/
+					/* begin timed window     */
+					/**************************/
+					ierr += win_MPI_window(tst, m, sbuf, rbuf, req, partner_rank);
+					/**************************/
+					/* end timed window       */
+					/**************************/
+					ORB_read(t3);
+					/* save the timings */
+					t[i] = ORB_cycles(t2, t1);
+					cos[i] = ORB_cycles(t3, t2);
+				}
+				/************************************************************/
+				/* END PERFORMANCE KERNEL -- samples gathered for this pair */
+				/************************************************************/
+				assert(ierr == 0);
+				win_measurement_bin(tst, m, t, cos, (node_id[my_rank] == node_id[partner_rank]));
+			} /* if valid pairing */
+		} /* for istage */
+		/* confident enough in the watched quantiles? */
+		if (!stop)
+			stop = measurement_converged(tst, m);
+	} /* for icycle */
+	free(t);
+	free(cos);
+	free(req);
+	comm_freebuffer(rbuf);
+#endif
+	return;
+}
+
+/**
+ \brief Converts the window time measurements (in timer ticks) to bin
+*/
+void win_measurement_bin(test_p tst, measurement_p m, ORB_tick_t *t, ORB_tick_t *cos, int LOCAL) {
+	ORB_tick_t cosmin;
+	int i, w;
+	/* bin these values as local or remote communication */
+	w = LOCAL ? onNodeWindow : offNodeWindow;
+	cosmin = ~((ORB_tick_t)0);
+	for (i = 0; i < tst->num_messages; i++) {
+		if (TICK_VALID(t[i]))
+			MEASUREMENT_BIN(m, winTimer, tick2bin(tst,t[i]))++;
+		if (TICK_VALID(cos[i]))
+			MEASUREMENT_BIN(m, w, tick2bin(tst,cos[i]))++;
+		/* save the minimum for now (invalid samples compare high) */
+		if ((cos[i] > 0) && (cos[i] < cosmin))
+			cosmin = cos[i];
+	}
+	/* now bin the minimum window for this communications pair */
+	if (TICK_VALID(cosmin))
+		MEASUREMENT_BIN(m, w + WIN_MIN, tick2bin(tst,cosmin))++;
+}